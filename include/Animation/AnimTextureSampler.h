@@ -0,0 +1,46 @@
+﻿#pragma once
+
+#include <vector>
+
+class AnimTexture;
+class Crowd;
+class Skeleton;
+struct Transform;
+template<typename T> struct TVec2;
+typedef TVec2<int> IVec2;
+template <typename TRACK> class TClip;
+
+// Largest difference found between a baked texture and the clip it was baked from
+struct AnimTextureBakeError
+{
+    float maxPositionError = 0.f;
+    // 1 - |dot| between both rotations, 0 when they match
+    float maxRotationError = 0.f;
+    float maxScaleError = 0.f;
+    
+}; // AnimTextureBakeError
+
+// CPU version of GetPose in Shaders/crowd.vert, samples the same baked model space transforms the GPU renders
+class AnimTextureSampler
+{
+public:
+    AnimTextureSampler() = delete;
+    AnimTextureSampler(const AnimTextureSampler&) = delete;
+    AnimTextureSampler& operator=(const AnimTextureSampler&) = delete;
+
+    static Transform SampleJoint(const AnimTexture& tex, unsigned int joint, const IVec2& frames, float t);
+    static void SamplePose(const AnimTexture& tex, const IVec2& frames, float t, unsigned int numJoints,
+        std::vector<Transform>& outPose);
+    // Poses of every actor, joint j of actor i is at i * numJoints + j. World space applies the actor transform
+    static void SampleCrowd(const AnimTexture& tex, const Crowd& crowd, unsigned int numJoints,
+        std::vector<Transform>& outPoses, bool bWorldSpace = false);
+
+    // Frames and interpolation time matching the columns written by BakeAnimationToTexture
+    static void GetFramesAtTime(float time, float start, float end, unsigned int texWidth, IVec2& outFrames,
+        float& outT);
+
+    template <typename TRACK>
+    static AnimTextureBakeError MeasureBakeError(const Skeleton& skeleton, const TClip<TRACK>& clip,
+        const AnimTexture& tex, unsigned int numSamples);
+    
+}; // AnimTextureSampler
@@ -1,5 +1,7 @@
 ﻿#pragma once
 
+#include <atomic>
+
 class AnimTexture;
 struct Vec3;
 struct Quat;
@@ -14,6 +16,16 @@ template <typename TRACK> class TClip;
 typedef TClip<TTransformTrack<Track<Vec3, 3>, Track<Quat, 4>>> Clip;
 typedef TClip<TTransformTrack<FastTrack<Vec3, 3>, FastTrack<Quat, 4>>> FastClip;
 
+// Filled by BakeAnimationToTexture, bakedColumns can be polled from another thread while baking
+struct AnimBakeStats
+{
+    std::atomic<unsigned int> bakedColumns{0};
+    unsigned int totalColumns = 0;
+    unsigned int numThreads = 0;
+    float elapsedMs = 0.f;
+    
+}; // AnimBakeStats
+
 class AnimationUtilities
 {
 public:
@@ -29,7 +41,9 @@ public:
     template <typename TRACK>
     static Pose MakeAdditivePose(const Skeleton& skeleton, const TClip<TRACK>& clip);
 
+    // Columns are split across numThreads workers (0 = hardware concurrency), each one with its own Pose
     template <typename TRACK>
-    static void BakeAnimationToTexture(const Skeleton& skeleton, const TClip<TRACK>& clip, AnimTexture& outTex);
+    static void BakeAnimationToTexture(const Skeleton& skeleton, const TClip<TRACK>& clip, AnimTexture& outTex,
+        unsigned int numThreads = 0, AnimBakeStats* outStats = nullptr);
     
 }; // AnimationUtilities
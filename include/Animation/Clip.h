@@ -1,16 +1,15 @@
 ﻿#pragma once
 
-#include <map>
 #include <string>
 #include <vector>
 
+#include "SkeletalMesh/Skeleton.h"
+
 struct Vec3;
 struct Quat;
-class Pose;
 template<typename T, unsigned int N> class Track;
 template <typename T, unsigned int N> class FastTrack;
 template <typename VTRACK, typename QTRACK> class TTransformTrack;
-typedef std::map<int, int> BoneMap;
 
 template <typename TRACK>
 class TClip
@@ -2,6 +2,8 @@
 
 #include <vector>
 
+#include "Physics/SpatialHashGrid.h"
+
 struct Vec3;
 struct Quat;
 struct Transform;
@@ -10,22 +12,44 @@ typedef TVec2<int> IVec2;
 template<typename T> class TClip;
 class Shader;
 
+// Update rate tiers, each one halves the rate of the previous one until the pose is frozen
+enum class CrowdLOD : unsigned char
+{
+    Full = 0,
+    Half,
+    Quarter,
+    Frozen,
+    
+}; // CrowdLOD
+
 class Crowd
 {
 public:
     unsigned int GetSize() const;
     Transform GetActor(unsigned int idx) const;
+    const IVec2& GetFrames(unsigned int idx) const;
+    float GetTime(unsigned int idx) const;
+    CrowdLOD GetLOD(unsigned int idx) const;
+    // Actors advanced by the last Update
+    unsigned int GetNumUpdatedActors() const;
 
     void Resize(unsigned int size);
     void SetActor(unsigned int idx, const Transform& t);
     void SetUniforms(const Shader* shader) const;
 
+    // Distances from the observer where actors switch to half rate, quarter rate and frozen
+    void SetLODDistances(float halfRate, float quarterRate, float frozen);
+    void UpdateLODs(const Vec3& observer);
+
     template <typename TRACK>
     void Update(float deltaTime, const TClip<TRACK>& clip, unsigned int texWidth);
 
     template <typename TRACK>
     void RandomizeTimes(const TClip<TRACK>& clip);
+    // Poisson-disk placement, no two actors closer than radius
     void RandomizePositions(const Vec3& min, const Vec3& max, float radius);
+    // Actors closer than radius to center, e.g. for separation or culling
+    void QueryNeighbours(const Vec3& center, float radius, std::vector<unsigned int>& outActors) const;
     
 protected:
     std::vector<Vec3> m_Positions;
@@ -35,9 +59,20 @@ protected:
     std::vector<float> m_Times;
     std::vector<float> m_CurrentPlayTimes;
     std::vector<float> m_NextPlayTimes;
+    
+    std::vector<CrowdLOD> m_LODs;
+    // Time accumulated since the actor was last updated
+    std::vector<float> m_PendingTimes;
+    std::vector<unsigned int> m_UpdatedActors;
+    float m_LODDistancesSq[3] = {30.f * 30.f, 60.f * 60.f, 100.f * 100.f};
+    unsigned int m_FrameCounter = 0;
+
+    // Kept in sync with m_Positions
+    SpatialHashGrid m_Grid;
 
     static float AdjustTime(float t, float start, float end, bool bLooping);
-    void UpdatePlaybackTimes(float dt, bool bLooping, float start, float end);
+    void GatherUpdatedActors(float dt);
+    void UpdatePlaybackTimes(bool bLooping, float start, float end);
     void UpdateFrameIndices(float start, float duration, unsigned int textWidth);
     void UpdateInterpolationTimes(float start, float duration, unsigned int textWidth);
     
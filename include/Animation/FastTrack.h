@@ -6,6 +6,9 @@ template <typename T, unsigned int N>
 class FastTrack : public Track<T, N>
 {
 public:
+    const std::vector<unsigned int>& GetIndexLookupTable() const;
+    std::vector<unsigned int>& GetIndexLookupTable();
+    
     void UpdateIndexLookupTable();
 
 protected:
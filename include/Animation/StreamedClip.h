@@ -0,0 +1,114 @@
+﻿#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Pose;
+struct Transform;
+template <typename TRACK> class TClip;
+
+// Layout: [StreamedClipHeader][name][joint IDs][blocks], every block holds framesPerBlock + 1 frames of numJoints
+// local transforms, the last frame is repeated as the first of the next block so sampling never spans two blocks
+static constexpr uint32_t STREAMED_CLIP_MAGIC = 0x4D525453; // "STRM"
+static constexpr uint32_t STREAMED_CLIP_VERSION = 1;
+
+struct StreamedClipHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numJoints;
+    uint32_t numFrames;
+    uint32_t framesPerBlock;
+    uint32_t numBlocks;
+    float startTime;
+    float endTime;
+    uint32_t bLooping;
+    uint32_t nameLength;
+    
+}; // StreamedClipHeader
+
+// Clip resampled at a fixed rate and kept on disk. Fixed duration blocks of keys are read on demand and the blocks
+// ahead of the playhead are prefetched on a background thread, memory is bounded by the window instead of the length
+class StreamedClip
+{
+public:
+    StreamedClip();
+    ~StreamedClip();
+
+    StreamedClip(const StreamedClip&) = delete;
+    StreamedClip& operator=(const StreamedClip&) = delete;
+
+    // Samples the clip over the rest pose, so components without a track are stored with their rest value
+    template <typename TRACK>
+    static bool Write(const char* path, const TClip<TRACK>& clip, const Pose& restPose, float sampleRate = 30.f,
+        float blockDuration = 2.f);
+
+    // numResidentBlocks is the window: the block being sampled plus the ones prefetched ahead of it
+    bool Open(const char* path, unsigned int numResidentBlocks = 3);
+    void Close();
+    bool IsOpen() const { return m_File.is_open(); }
+
+    const std::string& GetName() const { return m_Name; }
+    float GetStartTime() const { return m_StartTime; }
+    float GetEndTime() const { return m_EndTime; }
+    float GetDuration() const { return m_EndTime - m_StartTime; }
+    bool IsLooping() const { return m_bLooping; }
+    void SetLooping(bool bLooping) { m_bLooping = bLooping; }
+    
+    unsigned int GetNumBlocks() const { return m_NumBlocks; }
+    unsigned int GetNumResidentBlocks() const { return m_Blocks.size(); }
+    std::size_t GetBlockSize() const;
+    // Blocks Sample had to read itself because the prefetch didn't arrive in time
+    unsigned int GetNumStalls() const { return m_NumStalls; }
+
+    // Same contract as TClip::Sample, only the joints of the clip are written
+    float Sample(Pose& outPose, float t) const;
+
+protected:
+    struct Block
+    {
+        int index = -1;
+        std::vector<Transform> keys;
+    };
+    
+    float AdjustTimeToFitRange(float t) const;
+    bool ReadBlock(unsigned int blockIdx, std::vector<Transform>& outKeys) const;
+    // Must be called with m_BlocksMutex locked
+    int FindBlock(unsigned int blockIdx) const;
+    unsigned int FindSlotToEvict() const;
+    unsigned int GetBlocksAhead(unsigned int block) const;
+    void RequestPrefetch(unsigned int currentBlock) const;
+    void LoaderLoop();
+
+    std::string m_Name;
+    std::vector<unsigned int> m_JointIDs;
+    float m_StartTime = 0.f;
+    float m_EndTime = 0.f;
+    float m_FrameStep = 0.f;
+    unsigned int m_NumFrames = 0;
+    unsigned int m_FramesPerBlock = 0;
+    unsigned int m_NumBlocks = 0;
+    bool m_bLooping = false;
+
+    // Streaming and playback state, Sample is const like TClip::Sample but still reads and caches blocks
+    mutable std::ifstream m_File;
+    std::streamoff m_BlocksOffset = 0;
+    mutable std::mutex m_FileMutex;
+
+    mutable std::vector<Block> m_Blocks;
+    mutable unsigned int m_CurrentBlock = 0;
+    mutable unsigned int m_NumStalls = 0;
+    mutable std::mutex m_BlocksMutex;
+
+    std::thread m_Loader;
+    mutable std::vector<unsigned int> m_PrefetchQueue;
+    mutable std::condition_variable m_LoaderCondition;
+    bool m_bStopLoader = false;
+    
+}; // StreamedClip
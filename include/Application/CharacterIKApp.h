@@ -5,10 +5,12 @@
 #include "Animation/TransformTrack.h"
 #include "Animation/Track.h"
 #include "Core/Transform.h"
+#include "IK/TwoBoneIKBatch.h"
+#include "Physics/GroundProbe.h"
 #include "SkeletalMesh/Skeleton.h"
 
 class IKLeg;
-struct TriangleMesh;
+class IKLegVisualizer;
 class SkeletalMesh;
 class Texture;
 class Shader;
@@ -41,6 +43,7 @@ protected:
     // IK
     IKLeg* m_LeftLeg = nullptr;
 	IKLeg* m_RightLeg = nullptr;
+    TwoBoneIKBatch m_IKBatch;
     float m_AnkleOffset = 0.2f;
     float m_ToeLength = 0.3f;
 
@@ -59,7 +62,8 @@ protected:
     // Environment
     std::vector<SkeletalMesh> m_EnvironmentMeshes; // Should be StaticMesh
     Texture* m_EnvironmentTexture = nullptr;
-    std::vector<TriangleMesh> m_EnvironmentTriangles;
+    // Every foot ray of the frame is resolved through it
+    GroundProbe m_GroundProbe;
     bool bShowEnvironment = true;
 
     // Shaders
@@ -68,6 +72,8 @@ protected:
     
     // Debug
     DebugDrawer* m_CurrentPoseVisual = nullptr;
+    IKLegVisualizer* m_LeftLegVisual = nullptr;
+    IKLegVisualizer* m_RightLegVisual = nullptr;
     bool bShowCurrentPose = true;
     bool bShowIKPose = true;
     bool bDepthTest = false;
@@ -43,6 +43,9 @@ protected:
    
     Shader* m_CrowdShader = nullptr;
 
+    // Debug: compares every freshly baked texture against its clip, slow on startup
+    bool bMeasureBakeError = false;
+
     void SetCrowdSize(unsigned int size);
     
 }; // Application
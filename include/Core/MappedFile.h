@@ -0,0 +1,32 @@
+﻿#pragma once
+
+#include <cstddef>
+
+// Read-only view of a whole file mapped into memory, pages are loaded by the OS on first access
+class MappedFile
+{
+public:
+    MappedFile();
+    MappedFile(const char* path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool IsOpen() const { return m_Data != nullptr; }
+    const unsigned char* GetData() const { return m_Data; }
+    std::size_t GetSize() const { return m_Size; }
+
+    bool Open(const char* path);
+    void Close();
+
+protected:
+    const unsigned char* m_Data = nullptr;
+    std::size_t m_Size = 0;
+
+    // Native handles: file + mapping object on Windows, file descriptor on POSIX
+    void* m_FileHandle = nullptr;
+    void* m_MappingHandle = nullptr;
+    int m_FileDescriptor = -1;
+    
+}; // MappedFile
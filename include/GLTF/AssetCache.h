@@ -0,0 +1,61 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "SkeletalMesh/SkeletalMesh.h"
+#include "SkeletalMesh/Skeleton.h"
+
+struct Vec3;
+struct Quat;
+template <typename T, unsigned int N> class FastTrack;
+template <typename VTRACK, typename QTRACK> class TTransformTrack;
+template <typename TRACK> class TClip;
+typedef TClip<TTransformTrack<FastTrack<Vec3, 3>, FastTrack<Quat, 4>>> FastClip;
+
+// Layout: [CookedAssetHeader][skeleton][meshes][clips], every array is a uint32 count followed by raw elements
+static constexpr uint32_t COOKED_ASSET_MAGIC = 0x4B4F4F43; // "COOK"
+static constexpr uint32_t COOKED_ASSET_VERSION = 3;
+
+struct CookedAssetHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    // FNV-1a of the source file and its external buffers, the cache is stale when any of them changes
+    uint64_t sourceHash;
+    uint32_t numMeshes;
+    uint32_t numClips;
+    
+}; // CookedAssetHeader
+
+// Runtime ready data of a skinned glTF: rearranged skeleton, rearranged meshes and optimized rearranged clips
+struct CookedAsset
+{
+    Skeleton skeleton;
+    std::vector<SkeletalMesh> meshes;
+    std::vector<FastClip> clips;
+    
+}; // CookedAsset
+
+class AssetCache
+{
+public:
+    AssetCache() = delete;
+    AssetCache(const AssetCache&) = delete;
+    AssetCache& operator=(const AssetCache&) = delete;
+
+    // Loads "<gltfPath>.cooked" if it matches the source files, otherwise cooks the glTF and writes the cache
+    static bool LoadOrCook(const char* gltfPath, CookedAsset& outAsset);
+    static bool Cook(const char* gltfPath, CookedAsset& outAsset);
+    
+    static bool Load(const char* cachePath, uint64_t sourceHash, CookedAsset& outAsset);
+    static bool Save(const char* cachePath, uint64_t sourceHash, const CookedAsset& asset);
+    
+    static std::string GetCachePath(const char* gltfPath);
+    // Hash of the glTF folded with the hashes of the .bin files it references, 0 if any of them can't be read
+    static uint64_t HashSource(const char* gltfPath);
+    // 0 if the file can't be read
+    static uint64_t HashFile(const char* path);
+    
+}; // AssetCache
@@ -0,0 +1,53 @@
+﻿#pragma once
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct cgltf_data;
+struct Vec3;
+struct Quat;
+template<typename T, unsigned int N> class Track;
+template<typename VTRACK, typename QTRACK> class TTransformTrack;
+template<typename TRACK> class TClip;
+typedef TClip<TTransformTrack<Track<Vec3, 3>, Track<Quat, 4>>> Clip;
+struct ClipCatalogEntry;
+
+// Clips of a glTF file, names and time ranges are read on Open while the tracks are decoded on first use.
+// The parsed file stays alive until Close, so decoded clips only cost the memory of their tracks
+class ClipCatalog
+{
+public:
+    ClipCatalog();
+    // Takes ownership of data
+    explicit ClipCatalog(cgltf_data* data);
+    ~ClipCatalog();
+
+    ClipCatalog(const ClipCatalog&) = delete;
+    ClipCatalog& operator=(const ClipCatalog&) = delete;
+
+    bool Open(const char* path);
+    void Open(cgltf_data* data);
+    // Waits for background decoding before freeing the file
+    void Close();
+
+    unsigned int GetNumClips() const;
+    const std::string& GetName(unsigned int idx) const;
+    float GetStartTime(unsigned int idx) const;
+    float GetEndTime(unsigned int idx) const;
+    float GetDuration(unsigned int idx) const;
+    int FindClip(const std::string& name) const;
+    bool IsDecoded(unsigned int idx) const;
+
+    // Decodes the clip the first time it's requested, waits if it's being decoded in the background
+    const Clip& GetClip(unsigned int idx);
+    // Decodes the given clips on a background thread
+    void PrefetchAsync(const std::vector<unsigned int>& clips);
+    
+protected:
+    cgltf_data* m_Data = nullptr;
+    std::vector<std::unique_ptr<ClipCatalogEntry>> m_Entries;
+    std::vector<std::thread> m_Workers;
+    
+}; // ClipCatalog
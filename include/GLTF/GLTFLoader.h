@@ -1,5 +1,6 @@
 ﻿#pragma once
 
+#include <cstddef>
 #include <string>
 #include <vector>
 
@@ -8,6 +9,9 @@ struct cgltf_node;
 struct cgltf_accessor;
 struct cgltf_attribute;
 struct cgltf_skin;
+struct cgltf_mesh;
+struct cgltf_primitive;
+struct cgltf_animation;
 struct cgltf_animation_channel;
 struct Transform;
 class Pose;
@@ -21,26 +25,59 @@ template<typename TRACK> class TClip;
 typedef TClip<TTransformTrack<Track<Vec3, 3>, Track<Quat, 4>>> Clip;
 template<typename T, unsigned int N> class Track;
 
+// Filled by LoadGLTFFile
+struct GLTFLoadStats
+{
+    float parseMs = 0.f;
+    float loadBuffersMs = 0.f;
+    float validateMs = 0.f;
+    std::size_t bufferBytes = 0;
+    bool bMemoryMapped = false;
+    
+}; // GLTFLoadStats
+
 class GLTFLoader
 {
 public:
-    static cgltf_data* LoadGLTFFile(const char* path);
+    // Accepts .gltf and .glb. Memory mapped files and external .bin buffers are decoded straight from the mapped
+    // pages instead of being read into heap memory, they stay mapped until FreeGLTFFile
+    static cgltf_data* LoadGLTFFile(const char* path, bool bMemoryMap = true, GLTFLoadStats* outStats = nullptr);
     static void FreeGLTFFile(cgltf_data* data);
     static Pose LoadRestPose(const cgltf_data* data);
-    static Pose LoadBindPose(const cgltf_data* data);
+    // skinIdx < 0 merges the inverse bind matrices of every skin into one bind pose
+    static Pose LoadBindPose(const cgltf_data* data, int skinIdx = -1);
     static std::vector<std::string> LoadJointNames(const cgltf_data* data);
-    static Skeleton LoadSkeleton(const cgltf_data* data);
-    static std::vector<SkeletalMesh> LoadSkeletalMeshes(const cgltf_data* data);
-    static std::vector<SkeletalMesh> LoadStaticMeshes(const cgltf_data* data);
-    static std::vector<Clip> LoadAnimationClips(const cgltf_data* data);
+    static Skeleton LoadSkeleton(const cgltf_data* data, int skinIdx = -1);
+    // One skeleton per skin, they share the node hierarchy (rest pose and names are built once) so bone IDs of
+    // every mesh stay valid, only the bind pose comes from each skin
+    static std::vector<Skeleton> LoadSkinSkeletons(const cgltf_data* data);
+    // Primitives and animations are decoded on numThreads threads (0 = hardware concurrency), GL buffers are
+    // uploaded afterwards from the calling thread, which must own the GL context
+    static std::vector<SkeletalMesh> LoadSkeletalMeshes(const cgltf_data* data, unsigned int numThreads = 0);
+    // Also returns the skin of each mesh, the index into LoadSkinSkeletons
+    static std::vector<SkeletalMesh> LoadSkeletalMeshes(const cgltf_data* data, std::vector<int>& outSkinIndices,
+        unsigned int numThreads = 0);
+    static std::vector<SkeletalMesh> LoadStaticMeshes(const cgltf_data* data, unsigned int numThreads = 0);
+    static std::vector<Clip> LoadAnimationClips(const cgltf_data* data, unsigned int numThreads = 0);
+    static void LoadAnimationClip(Clip& outClip, const cgltf_animation& animation, const cgltf_data* data);
 
 private:
     static Transform GetLocalTransforms(const cgltf_node& n);
+    static Pose BindPoseFromRestPose(const cgltf_data* data, const Pose& restPose, int skinIdx);
+    // cgltf stores all nodes contiguously, the index is the pointer offset
     static int GetNodeIndex(const cgltf_node* target, const cgltf_node* allNodes, unsigned int numNodes);
+    // Node index of every skin joint, so joint attributes are remapped with a table lookup
+    static std::vector<int> GetSkinJointNodes(const cgltf_skin* skin, const cgltf_node* nodes, unsigned int numNodes);
+    // Tightly packed float/unsigned accessors are copied or converted in bulk, other layouts are read per element
     static void GetScalarValues(std::vector<float>& out, unsigned int compCount, const cgltf_accessor& accessor);
-    static void MeshFromAttribute(SkeletalMesh& outMesh, const cgltf_attribute& attribute, const cgltf_skin* skin,
-        const cgltf_node* nodes, unsigned int nodeCount);
-    static std::vector<SkeletalMesh> LoadMeshes(const cgltf_data* data, bool bMustHaveSkin);
+    static void GetIndexValues(std::vector<unsigned int>& out, const cgltf_accessor& accessor);
+    static void MeshFromAttribute(SkeletalMesh& outMesh, const cgltf_attribute& attribute,
+        const std::vector<int>& skinJointNodes);
+    // Dense target accessors are stored sparse, only vertices with a non zero delta are kept
+    static void MorphTargetsFromPrimitive(SkeletalMesh& outMesh, const cgltf_primitive& primitive,
+        const cgltf_mesh& mesh);
+    static std::vector<SkeletalMesh> LoadMeshes(const cgltf_data* data, bool bMustHaveSkin, unsigned int numThreads,
+        std::vector<int>* outSkinIndices);
     template<typename T, int N>
     static void TrackFromChannel(Track<T, N>& result, const cgltf_animation_channel& channel);
     
@@ -2,6 +2,9 @@
 
 #include <vector>
 
+#include "IK/IKConstraint.h"
+#include "IK/IKWarmStart.h"
+
 struct Transform;
 
 class CCDSolver
@@ -16,17 +19,36 @@ public:
     void Resize(unsigned int newSize);
     void SetNumSteps(unsigned int numSteps);
     void SetThreshold(float threshold);
+    // Applied to the joint right after it's rotated, so the next joints already correct from the constrained pose
+    void SetConstraint(unsigned int idx, const IKConstraint& constraint);
+    const IKConstraint& GetConstraint(unsigned int idx) const;
+    // Warm start and early out, see IKWarmStart
+    void SetWarmStart(bool bWarmStart);
+    bool IsWarmStarting() const;
+    void SetEarlyOutDistance(float distance);
+    float GetEarlyOutDistance() const;
+    unsigned int GetLastNumIterations() const;
+    const IKSolverStats& GetStats() const;
+    void ResetStats();
 
     const Transform& operator[](unsigned int idx) const;
     Transform& operator[](unsigned int idx);
     
     Transform GetGlobalTransform(unsigned int idx) const;
 
+    // Each iteration is O(n): world transforms are built once per iteration and the effector is tracked relative
+    // to the joint being rotated, since rotating a joint doesn't change the joints before it
     bool Solve(const Transform& target);
 
 protected:
     std::vector<Transform> m_IKChain;
+    std::vector<Transform> m_WorldChain;
+    std::vector<IKConstraint> m_Constraints;
     unsigned int m_NumSteps = 15;
     float m_Threshold = .00001f;
+
+    IKWarmStart m_WarmStart;
+
+    bool Iterate(const Vec3& goal, unsigned int& outNumIterations);
     
 }; // CCDSolver
@@ -2,7 +2,9 @@
 
 #include <vector>
 
-struct Vec3;
+#include "IK/IKConstraint.h"
+#include "IK/IKWarmStart.h"
+
 struct Transform;
 
 class FABRIKSolver
@@ -23,6 +25,17 @@ public:
     void SetNumSteps(unsigned int numSteps);
     void SetThreshold(float threshold);
     void SetLocalTransform(unsigned int idx, const Transform& t);
+    // Applied while the solved positions are turned into rotations, once per iteration
+    void SetConstraint(unsigned int idx, const IKConstraint& constraint);
+    const IKConstraint& GetConstraint(unsigned int idx) const;
+    // Warm start and early out, see IKWarmStart
+    void SetWarmStart(bool bWarmStart);
+    bool IsWarmStarting() const;
+    void SetEarlyOutDistance(float distance);
+    float GetEarlyOutDistance() const;
+    unsigned int GetLastNumIterations() const;
+    const IKSolverStats& GetStats() const;
+    void ResetStats();
 
     Transform GetGlobalTransform(unsigned int idx) const;
 
@@ -35,10 +48,15 @@ protected:
 
     std::vector<Vec3> m_WorldChain;
     std::vector<float> m_Lengths;
+    std::vector<IKConstraint> m_Constraints;
+
+    IKWarmStart m_WarmStart;
 
     void IKChainToWorld();
     void IterateForward(const Vec3& base);
     void IterateBackwards(const Vec3& goal);
+    // Also applies the constraints and moves m_WorldChain to the constrained positions
     void WorldToIKChain();
+    bool Iterate(const Vec3& goal, unsigned int& outNumIterations);
     
 }; // FABRIKSolver
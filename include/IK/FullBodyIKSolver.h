@@ -0,0 +1,88 @@
+﻿#pragma once
+
+#include <vector>
+
+#include "Core/Transform.h"
+#include "IK/IKSolverStats.h"
+
+class Pose;
+
+// Joint pulled towards a world space target, the weight counts when branches pull a shared joint apart
+struct IKEffector
+{
+    unsigned int joint = 0;
+    Vec3 target;
+    float weight = 1.f;
+    
+}; // IKEffector
+
+// Multi-effector FABRIK over a whole pose. Every joint between the root and an effector is solved together as one
+// tree: joints where chains branch (sub-bases, e.g. the chest for both arms and the head) move rigidly with their
+// branches, turned by the rotation that best fits their child offsets to where the branches want them (weighted by
+// the effectors under each branch), so the spine is shared instead of solved once per chain. The root stays in place
+class FullBodyIKSolver
+{
+public:
+    FullBodyIKSolver();
+
+    unsigned int GetRoot() const;
+    unsigned int GetNumEffectors() const;
+    const IKEffector& GetEffector(unsigned int idx) const;
+    unsigned int GetNumSteps() const;
+    float GetThreshold() const;
+    unsigned int GetLastNumIterations() const;
+    const IKSolverStats& GetStats() const;
+
+    void SetRoot(unsigned int rootIdx);
+    // Returns the effector index, effectors must be below the root
+    unsigned int AddEffector(unsigned int jointIdx, float weight = 1.f);
+    void SetEffectorTarget(unsigned int idx, const Vec3& target);
+    void SetEffectorWeight(unsigned int idx, float weight);
+    void ClearEffectors();
+    void SetNumSteps(unsigned int numSteps);
+    void SetThreshold(float threshold);
+    void ResetStats();
+
+    // Targets are in world space, model places the pose in the world. Only the joints in the tree are written
+    bool Solve(Pose& pose, const Transform& model);
+
+protected:
+    unsigned int m_Root = 0;
+    std::vector<IKEffector> m_Effectors;
+    unsigned int m_NumSteps = 15;
+    float m_Threshold = .00001f;
+    unsigned int m_LastNumIterations = 0;
+    IKSolverStats m_Stats;
+
+    // Tree of solved joints, parents always before their children. Rebuilt when the effectors or the pose change
+    bool m_bDirty = true;
+    unsigned int m_PoseSize = 0;
+    std::vector<unsigned int> m_Joints;
+    std::vector<int> m_Parents;
+    std::vector<std::vector<unsigned int>> m_Children;
+    std::vector<int> m_NodeEffectors;
+    std::vector<int> m_EffectorNodes; // -1 for effectors that aren't below the root
+    std::vector<float> m_Weights; // Sum of the effector weights under each node
+
+    // Per solve
+    Transform m_RootParentWorld;
+    std::vector<Transform> m_World;
+    std::vector<Vec3> m_Positions;
+    std::vector<float> m_Lengths;
+    std::vector<Vec3> m_Offsets; // From the parent, rotated rigidly with it when the parent is a sub-base
+    std::vector<Vec3> m_FitFrom;
+    std::vector<Vec3> m_FitTo;
+    std::vector<float> m_FitWeights;
+
+    void BuildTree(const Pose& pose);
+    // Only needs the tree, so weight changes don't rebuild it
+    void UpdateWeights();
+    void GatherPositions(const Pose& pose, const Transform& model);
+    bool HasReachedTargets() const;
+    void IterateBackwards();
+    void IterateForward(const Vec3& base);
+    // Rotation that best turns m_FitFrom into m_FitTo
+    Quat FitRotation() const;
+    void WorldToPose(Pose& pose);
+    
+}; // FullBodyIKSolver
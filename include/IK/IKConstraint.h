@@ -0,0 +1,48 @@
+﻿#pragma once
+
+#include "Core/BasicUtils.h"
+#include "Core/Vec3.h"
+
+struct Quat;
+
+enum class IKConstraintType : unsigned char
+{
+    None,
+    Hinge,
+    BallSocket,
+    Twist
+};
+
+// Limits a joint's local rotation (relative to its parent). Angles are in radians and measured from the identity
+// rotation, axes are unit vectors: hinge and cone axes are in the parent's space, the bone axis is the direction to
+// the child in the joint's own space
+class IKConstraint
+{
+public:
+    IKConstraint();
+
+    // Only rotates around axis, between minAngle and maxAngle. Knees and elbows
+    static IKConstraint Hinge(const Vec3& axis, float minAngle, float maxAngle);
+    // The bone stays inside a cone of maxSwing around coneAxis, with its own twist limited too. Hips and shoulders
+    static IKConstraint BallSocket(const Vec3& boneAxis, const Vec3& coneAxis, float maxSwing,
+        float minTwist = -PI, float maxTwist = PI);
+    // Only limits the rotation around the bone, any swing is allowed. Forearms and spines
+    static IKConstraint Twist(const Vec3& boneAxis, float minTwist, float maxTwist);
+
+    IKConstraintType GetType() const { return m_Type; }
+    
+    Quat Apply(const Quat& localRotation) const;
+
+protected:
+    IKConstraintType m_Type = IKConstraintType::None;
+    Vec3 m_Axis = {0.f, 0.f, 1.f};
+    Vec3 m_BoneAxis = {0.f, 1.f, 0.f};
+    float m_MinAngle = 0.f;
+    float m_MaxAngle = 0.f;
+    float m_MaxSwing = PI;
+
+    Quat ApplyHinge(const Quat& localRotation) const;
+    Quat ApplyBallSocket(const Quat& localRotation) const;
+    Quat ApplyTwist(const Quat& localRotation) const;
+    
+}; // IKConstraint
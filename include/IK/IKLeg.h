@@ -2,21 +2,19 @@
 
 #include <string>
 
-#include "FABRIKSolver.h"
 #include "Animation/Track.h"
+#include "IK/TwoBoneIKSolver.h"
 #include "SkeletalMesh/Pose.h"
 
-class DebugDrawer;
+class TwoBoneIKBatch;
 
+// Headless, never touches the GPU. IKLegVisualizer draws a leg when debugging
 class IKLeg
 {
 public:
     IKLeg();
     IKLeg(const Skeleton& skeleton, const std::string& hip, const std::string& knee, const std::string& ankle,
         const std::string& toe);
-    IKLeg(const IKLeg& other);
-    IKLeg& operator=(const IKLeg& other);
-    ~IKLeg();
 
     const Pose& GetPose() const { return m_IKPose; }
     unsigned int GetHipIdx() const { return m_HipIdx; }
@@ -24,17 +22,22 @@ public:
     unsigned int GetAnkleIdx() const { return m_AnkleIdx; }
     unsigned int GetToeIdx() const { return m_ToeIdx; }
     float GetAnkleOffset() const { return m_AnkleOffset; }
+    const TwoBoneIKSolver& GetSolver() const { return m_Solver; }
+    const Vec3& GetKneeDirection() const { return m_KneeDirection; }
 
     void SetAnkleOffset(float ankleOffset) { m_AnkleOffset = ankleOffset; }
     void SetPinTrack(const ScalarTrack& pinTrack) { m_PinTrack = pinTrack; }
+    // Model space direction the knee is pushed towards, glTF characters face +Z
+    void SetKneeDirection(const Vec3& kneeDirection) { m_KneeDirection = kneeDirection; }
 
     void SolveForLeg(const Transform& model, const Pose& pose, const Vec3& ankleTargetPosition);
+    // Queues the leg, the batch writes the hip and knee straight into pose when solved
+    void AddToBatch(TwoBoneIKBatch& batch, const Transform& model, Pose& pose, const Vec3& ankleTargetPosition) const;
     float GetPinValue(float alpha) const;
-    void Draw(const Mat4& mv, const Vec3& legColor) const;
 
 protected:
     Pose m_IKPose;
-    FABRIKSolver m_Solver;
+    TwoBoneIKSolver m_Solver;
     ScalarTrack m_PinTrack;
 
     unsigned int m_HipIdx = 0;
@@ -42,9 +45,7 @@ protected:
     unsigned int m_AnkleIdx = 0;
     unsigned int m_ToeIdx = 0;
 
-    DebugDrawer* m_LineVisuals = nullptr;
-    DebugDrawer* m_PointVisuals = nullptr;
-    
     float m_AnkleOffset = 0.f; // The ankle is not flat on the ground
+    Vec3 m_KneeDirection = {0.f, 0.f, 1.f};
     
-}; // DebugDrawer
+}; // IKLeg
@@ -0,0 +1,17 @@
+﻿#pragma once
+
+// Accumulated by the iterative solvers on every Solve until ResetStats
+struct IKSolverStats
+{
+    unsigned int numSolves = 0;
+    unsigned int numIterations = 0;
+    unsigned int numReached = 0;
+    unsigned int numEarlyOuts = 0; // Warm started solves whose target barely moved, no iterations run
+
+    float GetAverageIterations() const
+    {
+        return numSolves > 0 ? static_cast<float>(numIterations) / static_cast<float>(numSolves) : 0.f;
+    
+    } // GetAverageIterations
+    
+}; // IKSolverStats
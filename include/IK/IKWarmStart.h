@@ -0,0 +1,42 @@
+﻿#pragma once
+
+#include <vector>
+
+#include "Core/Vec3.h"
+#include "IK/IKSolverStats.h"
+
+struct Transform;
+
+// Warm start and stats bookkeeping shared by the iterative solvers. Keeps the chain of the last real solve: the next
+// solve starts from its rotations, and is skipped when the target and the chain root are still within the early out
+// distance of what was actually solved
+class IKWarmStart
+{
+public:
+    IKWarmStart();
+
+    void SetEnabled(bool bEnabled);
+    bool IsEnabled() const;
+    void SetEarlyOutDistance(float distance);
+    float GetEarlyOutDistance() const;
+    unsigned int GetLastNumIterations() const;
+    const IKSolverStats& GetStats() const;
+    void ResetStats();
+
+    // Copies the rotations of the last solve into chain, true if that solve can be reused as is
+    bool Restore(std::vector<Transform>& chain, const Vec3& goal) const;
+    // Only counts the skipped solve, the last solve stays the reference. Returns whether it reached its target
+    bool RecordEarlyOut();
+    void RecordSolve(const std::vector<Transform>& chain, const Vec3& goal, bool bReached,
+        unsigned int numIterations);
+
+protected:
+    bool m_bEnabled = false;
+    float m_EarlyOutDistance = .0001f;
+    std::vector<Transform> m_LastSolution;
+    Vec3 m_LastTarget;
+    bool m_bLastReached = false;
+    unsigned int m_LastNumIterations = 0;
+    IKSolverStats m_Stats;
+    
+}; // IKWarmStart
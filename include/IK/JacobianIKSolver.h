@@ -0,0 +1,60 @@
+﻿#pragma once
+
+#include <vector>
+
+#include "IK/IKConstraint.h"
+#include "IK/IKSolverStats.h"
+
+struct Transform;
+
+// Damped least squares solver, every joint rotates freely around the three world axes and the update for all of them
+// is solved at once, so joints can be weighted and it doesn't stall on configurations where CCD and FABRIK crawl
+class JacobianIKSolver
+{
+public:
+    JacobianIKSolver();
+    
+    unsigned int GetSize() const;
+    unsigned int GetNumSteps() const;
+    float GetThreshold() const;
+    float GetDamping() const;
+    float GetJointWeight(unsigned int idx) const;
+
+    void Resize(unsigned int newSize);
+    void SetNumSteps(unsigned int numSteps);
+    void SetThreshold(float threshold);
+    // Relative to the chain length, higher values are more stable near singularities but converge slower
+    void SetDamping(float damping);
+    // How much the joint takes from each update, 0 locks it
+    void SetJointWeight(unsigned int idx, float weight);
+    // Applied to every joint after each update
+    void SetConstraint(unsigned int idx, const IKConstraint& constraint);
+    const IKConstraint& GetConstraint(unsigned int idx) const;
+    unsigned int GetLastNumIterations() const;
+    const IKSolverStats& GetStats() const;
+    void ResetStats();
+
+    const Transform& operator[](unsigned int idx) const;
+    Transform& operator[](unsigned int idx);
+    
+    Transform GetGlobalTransform(unsigned int idx) const;
+
+    // The effector only has a position so J * W * J^T is 3x3 whatever the chain length, each iteration is O(n) and
+    // doesn't allocate
+    bool Solve(const Transform& target);
+
+protected:
+    std::vector<Transform> m_IKChain;
+    std::vector<Transform> m_WorldChain;
+    std::vector<IKConstraint> m_Constraints;
+    std::vector<float> m_Weights;
+    unsigned int m_NumSteps = 15;
+    float m_Threshold = .00001f;
+    float m_Damping = .05f;
+
+    unsigned int m_LastNumIterations = 0;
+    IKSolverStats m_Stats;
+
+    void UpdateWorldChain();
+    
+}; // JacobianIKSolver
@@ -0,0 +1,85 @@
+﻿#pragma once
+
+#include <vector>
+
+#include "Core/Quat.h"
+
+struct Transform;
+struct Vec3;
+class Pose;
+
+// Solves many root/middle/end chains (e.g. the legs of a whole crowd) in one pass. Chains are gathered into one array
+// per component so the solve runs on four chains at a time with SSE, then only the root and middle local rotations
+// are written back into each pose. Chains added from the same pose must not be inside each other's hierarchy
+class TwoBoneIKBatch
+{
+public:
+    TwoBoneIKBatch();
+
+    unsigned int GetSize() const;
+    float GetThreshold() const;
+    bool IsReachable(unsigned int idx) const;
+
+    void SetThreshold(float threshold);
+    void Reserve(unsigned int numChains);
+    // Keeps the memory so refilling the batch every frame doesn't allocate
+    void Clear();
+
+    // Returns the chain index, bendDirection is the world direction the middle joint is pushed towards (optional)
+    unsigned int AddChain(Pose& pose, const Transform& model, unsigned int rootIdx, unsigned int middleIdx,
+        unsigned int endIdx, const Vec3& target);
+    unsigned int AddChain(Pose& pose, const Transform& model, unsigned int rootIdx, unsigned int middleIdx,
+        unsigned int endIdx, const Vec3& target, const Vec3& bendDirection);
+
+    void Solve();
+
+protected:
+    struct SoAVec3
+    {
+        std::vector<float> x;
+        std::vector<float> y;
+        std::vector<float> z;
+    };
+
+    struct SoAQuat
+    {
+        std::vector<float> x;
+        std::vector<float> y;
+        std::vector<float> z;
+        std::vector<float> w;
+    };
+
+    struct ChainInfo
+    {
+        Pose* pose;
+        unsigned int rootIdx;
+        unsigned int middleIdx;
+        Quat parentRotation;
+        Quat rootRotation;
+    };
+
+    float m_Threshold = .00001f;
+    std::vector<ChainInfo> m_Chains;
+
+    // Gathered world space inputs
+    SoAVec3 m_Root;
+    SoAVec3 m_Middle;
+    SoAVec3 m_End;
+    SoAVec3 m_Target;
+    SoAVec3 m_BendDirection;
+    std::vector<float> m_HasBendDirection;
+
+    // World space corrections: root bend, middle bend, swing to the target and twist towards the bend direction
+    SoAQuat m_RootBend;
+    SoAQuat m_MiddleBend;
+    SoAQuat m_Swing;
+    SoAQuat m_Twist;
+    std::vector<unsigned char> m_Reachable;
+
+    void SolveChains();
+    // Solves the chains from first on, one per lane of T (float or four chains in an SSE register)
+    template <typename T>
+    void SolveLanes(unsigned int first);
+    void WriteBack();
+    
+}; // TwoBoneIKBatch
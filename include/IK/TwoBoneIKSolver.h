@@ -0,0 +1,46 @@
+﻿#pragma once
+
+#include <vector>
+
+#include "Core/Vec3.h"
+
+struct Transform;
+
+// Closed-form solver for root/middle/end chains (hip/knee/ankle, shoulder/elbow/wrist). Element 0 is in world space,
+// the other two are local to their parent, same layout as the iterative solvers
+class TwoBoneIKSolver
+{
+public:
+    TwoBoneIKSolver();
+
+    unsigned int GetSize() const;
+    float GetThreshold() const;
+    const Transform& GetLocalTransform(unsigned int idx) const;
+    Transform& GetLocalTransform(unsigned int idx);
+    const Vec3& GetPoleVector() const;
+    bool HasPoleVector() const;
+
+    const Transform& operator[](unsigned int idx) const;
+    Transform& operator[](unsigned int idx);
+
+    void SetThreshold(float threshold);
+    void SetLocalTransform(unsigned int idx, const Transform& t);
+    // World position the middle joint bends towards, without one the current bend plane is kept
+    void SetPoleVector(const Vec3& pole);
+    void ClearPoleVector();
+
+    Transform GetGlobalTransform(unsigned int idx) const;
+
+    // Returns false when the target is out of reach, the chain is still stretched towards it
+    bool Solve(const Transform& target);
+
+protected:
+    static constexpr unsigned int SIZE = 3;
+    
+    std::vector<Transform> m_IKChain;
+    float m_Threshold = .00001f;
+
+    Vec3 m_PoleVector;
+    bool m_bHasPole = false;
+    
+}; // TwoBoneIKSolver
@@ -0,0 +1,77 @@
+﻿#pragma once
+
+#include <vector>
+
+#include "Core/Vec3.h"
+#include "Physics/Ray.h"
+
+struct TriangleMesh;
+
+struct GroundProbeHit
+{
+    Vec3 point;
+    // Facing the ray origin
+    Vec3 normal;
+    float distance = 0.f;
+    bool bHit = false;
+    
+}; // GroundProbeHit
+
+// Static triangles bucketed once into a uniform grid over XZ, rays are queued during the frame and resolved together.
+// A downward ray only visits its own cell, other rays walk the cells under them and stop at the first cell that
+// contains a hit
+class GroundProbe
+{
+public:
+    explicit GroundProbe(float cellSize = 1.f);
+
+    float GetCellSize() const { return m_CellSize; }
+    unsigned int GetNumTriangles() const { return m_Triangles.size(); }
+    unsigned int GetNumRays() const { return m_Rays.size(); }
+    // Triangles tested by the last Resolve
+    unsigned int GetLastNumTriangleTests() const { return m_LastNumTriangleTests; }
+
+    // Taken by the next Build, which grows it if the grid would get too many cells
+    void SetCellSize(float cellSize);
+    // Copies the triangles, call again when the environment changes
+    void Build(const std::vector<TriangleMesh>& triangles);
+
+    // Queues a ray and returns its index for GetHit, valid until ClearRays
+    unsigned int AddRay(const Ray& ray, float maxDistance = -1.f);
+    void ClearRays();
+    // Traces every queued ray, sorted by starting cell so rays hitting the same ground run together
+    void Resolve();
+    const GroundProbeHit& GetHit(unsigned int rayIdx) const;
+
+    // Immediate single ray, nearest hit closer than maxDistance (negative means unbounded)
+    bool Raycast(const Ray& ray, GroundProbeHit& outHit, float maxDistance = -1.f) const;
+    
+protected:
+    static constexpr unsigned int MAX_CELLS = 1u << 20;
+    
+    float m_CellSize = 1.f;
+    float m_InvCellSize = 1.f;
+    float m_MinX = 0.f;
+    float m_MinZ = 0.f;
+    int m_NumCellsX = 0;
+    int m_NumCellsZ = 0;
+
+    std::vector<TriangleMesh> m_Triangles;
+    // Triangles of cell c are m_CellTriangles[m_CellStarts[c]] until m_CellTriangles[m_CellStarts[c + 1]]
+    std::vector<unsigned int> m_CellStarts;
+    std::vector<unsigned int> m_CellTriangles;
+
+    std::vector<Ray> m_Rays;
+    std::vector<float> m_MaxDistances;
+    std::vector<GroundProbeHit> m_Hits;
+    std::vector<unsigned int> m_RayOrder;
+    std::vector<unsigned int> m_RayCells;
+    unsigned int m_LastNumTriangleTests = 0;
+
+    int GetCellX(float x) const;
+    int GetCellZ(float z) const;
+    
+    // Adds the number of triangles tested to outNumTests
+    bool Trace(const Ray& ray, float maxDistance, GroundProbeHit& outHit, unsigned int& outNumTests) const;
+    
+}; // GroundProbe
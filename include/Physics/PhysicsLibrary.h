@@ -10,5 +10,7 @@ public:
     PhysicsLibrary() = delete;
 
     static bool RaycastTriangle(const Ray& ray, const TriangleMesh& triangle, Vec3& hitPoint);
+    // Hit at ray.origin + ray.direction * outT
+    static bool RaycastTriangle(const Ray& ray, const TriangleMesh& triangle, float& outT);
     
 }; // PhysicsLibrary
@@ -0,0 +1,58 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "Core/Vec3.h"
+
+// Uniform grid of points hashed by cell, ids are dense indices owned by the caller (e.g. crowd actors).
+// Queries cost min(cells overlapping the search sphere, points inserted): small radii only visit the overlapping
+// cells, radii spanning more cells than there are points scan the occupied cells. Moving a point only touches its
+// old and new cells
+class SpatialHashGrid
+{
+public:
+    explicit SpatialHashGrid(float cellSize = 1.f);
+
+    float GetCellSize() const { return m_CellSize; }
+    unsigned int GetSize() const { return m_NumPoints; }
+    bool Contains(unsigned int id) const;
+
+    // Rehashes every point already inserted
+    void SetCellSize(float cellSize);
+    void Clear();
+    
+    void Insert(unsigned int id, const Vec3& position);
+    void Remove(unsigned int id);
+    void Move(unsigned int id, const Vec3& position);
+
+    // Ids closer than radius to center, outIds is cleared first
+    void Query(const Vec3& center, float radius, std::vector<unsigned int>& outIds) const;
+    bool AnyWithinRadius(const Vec3& center, float radius) const;
+    
+protected:
+    static constexpr unsigned int INVALID_SLOT = ~0u;
+    
+    float m_CellSize = 1.f;
+    float m_InvCellSize = 1.f;
+    unsigned int m_NumPoints = 0;
+    
+    std::unordered_map<uint64_t, std::vector<unsigned int>> m_Cells;
+    // Per id: position, cell key and slot inside the cell (INVALID_SLOT if not inserted)
+    std::vector<Vec3> m_Positions;
+    std::vector<uint64_t> m_Keys;
+    std::vector<unsigned int> m_Slots;
+
+    int GetCellCoord(float value) const;
+    static uint64_t GetCellKey(int x, int y, int z);
+    uint64_t GetCellKey(const Vec3& position) const;
+    
+    void AddToCell(unsigned int id, uint64_t key);
+    void RemoveFromCell(unsigned int id);
+
+    // Calls visitor(id, distSq) for every point in the cells overlapping the sphere until it returns false
+    template <typename VISITOR>
+    void VisitSphere(const Vec3& center, float radius, VISITOR visitor) const;
+    
+}; // SpatialHashGrid
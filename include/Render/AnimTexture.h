@@ -1,5 +1,8 @@
 ﻿#pragma once
 
+#include <memory>
+
+class MappedFile;
 struct Quat;
 struct Vec3;
 template <typename T> struct TVec4;
@@ -13,14 +16,17 @@ public:
     AnimTexture& operator=(const AnimTexture& other);
     ~AnimTexture();
 
-    const float* GetData() const { return m_Data; }
+    const float* GetData() const { return m_Data != nullptr ? m_Data : m_MappedData; }
+    float* GetData();
     unsigned int GetSize() const { return m_Size; }
     unsigned int GetHandle() const { return m_Handle; }
 
     void Resize(unsigned int newSize);
+    // Views texels owned by a mapped file, they are copied only if the texture is modified
+    void SetMappedData(const std::shared_ptr<MappedFile>& file, const float* data, unsigned int size);
 
-    void Load(const char* path);
-    void Save(const char* path) const;
+    bool Load(const char* path);
+    bool Save(const char* path) const;
     void UploadTextureDataToGPU();
 
     void SetTexel(unsigned int x, unsigned int y, const Vec3& v);
@@ -34,5 +40,10 @@ protected:
     float* m_Data = nullptr;
     unsigned int m_Size = 0;
     unsigned int m_Handle = 0;
+
+    std::shared_ptr<MappedFile> m_MappedFile;
+    const float* m_MappedData = nullptr;
+
+    void DetachFromMappedFile();
     
 }; // AnimTexture
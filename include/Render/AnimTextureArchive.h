@@ -0,0 +1,75 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class AnimTexture;
+class MappedFile;
+
+// On-disk layout, little endian:
+// [AnimTextureFileHeader][AnimTextureClipEntry * numClips][texels of each clip, ANIM_TEXTURE_DATA_ALIGNMENT aligned]
+static constexpr uint32_t ANIM_TEXTURE_MAGIC = 0x58455441; // "ATEX"
+static constexpr uint32_t ANIM_TEXTURE_VERSION = 1;
+static constexpr uint32_t ANIM_TEXTURE_DATA_ALIGNMENT = 16;
+static constexpr unsigned int ANIM_TEXTURE_MAX_NAME = 64;
+
+enum class AnimTextureFormat : uint32_t
+{
+    RGBA32F = 0,
+    
+}; // AnimTextureFormat
+
+struct AnimTextureFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numClips;
+    uint32_t clipTableOffset;
+    
+}; // AnimTextureFileHeader
+
+struct AnimTextureClipEntry
+{
+    char name[ANIM_TEXTURE_MAX_NAME];
+    uint32_t width;
+    uint32_t height;
+    AnimTextureFormat format;
+    uint32_t checksum; // FNV-1a over the texel words
+    uint64_t dataOffset;
+    uint64_t dataSize;
+    
+}; // AnimTextureClipEntry
+
+// Memory-mapped set of baked clips. Open only reads the header and clip table, texels are paged in when a clip is
+// loaded and uploaded to the GPU straight from the mapped file
+class AnimTextureArchive
+{
+public:
+    AnimTextureArchive();
+    ~AnimTextureArchive();
+
+    AnimTextureArchive(const AnimTextureArchive&) = delete;
+    AnimTextureArchive& operator=(const AnimTextureArchive&) = delete;
+
+    bool IsOpen() const { return m_Clips != nullptr; }
+    unsigned int GetNumClips() const;
+    const AnimTextureClipEntry& GetClipEntry(unsigned int idx) const;
+    int FindClip(const std::string& name) const;
+
+    bool Open(const char* path);
+    void Close();
+    // The upload reads every texel anyway, so verifying the checksum first costs no extra paging
+    bool LoadClip(unsigned int idx, AnimTexture& outTex, bool bVerifyChecksum = true) const;
+
+    static bool Save(const char* path, const std::vector<std::string>& names,
+        const std::vector<const AnimTexture*>& textures);
+    static uint32_t Checksum(const float* data, uint64_t numFloats);
+
+protected:
+    std::shared_ptr<MappedFile> m_File;
+    const AnimTextureFileHeader* m_Header = nullptr;
+    const AnimTextureClipEntry* m_Clips = nullptr;
+    
+}; // AnimTextureArchive
@@ -4,6 +4,7 @@
 
 class FABRIKSolver;
 class CCDSolver;
+class TwoBoneIKSolver;
 class Pose;
 class Shader;
 struct Vec3;
@@ -41,6 +42,8 @@ public:
     void PointsFromIKSolver(const CCDSolver& solver);
     void LinesFromIKSolver(const FABRIKSolver& solver);
     void PointsFromIKSolver(const FABRIKSolver& solver);
+    void LinesFromIKSolver(const TwoBoneIKSolver& solver);
+    void PointsFromIKSolver(const TwoBoneIKSolver& solver);
 
 protected:
     Shader* m_Shader;
@@ -0,0 +1,28 @@
+﻿#pragma once
+
+#include "Render/DebugDrawer.h"
+
+class IKLeg;
+class Pose;
+struct Transform;
+
+// Debug lines and points for an IKLeg. Needs a GL context, so only create it where legs are drawn
+class IKLegVisualizer
+{
+public:
+    IKLegVisualizer();
+
+    IKLegVisualizer(const IKLegVisualizer&) = delete;
+    IKLegVisualizer& operator=(const IKLegVisualizer&) = delete;
+
+    // From the leg's own solver, after IKLeg::SolveForLeg
+    void FromSolver(const IKLeg& leg);
+    // From a pose the leg is already solved into, e.g. by a TwoBoneIKBatch
+    void FromPose(const IKLeg& leg, const Transform& model, const Pose& pose);
+    void Draw(const Mat4& mvp, const Vec3& color);
+
+protected:
+    DebugDrawer m_Lines;
+    DebugDrawer m_Points;
+    
+}; // IKLegVisualizer
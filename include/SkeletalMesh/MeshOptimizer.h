@@ -0,0 +1,28 @@
+﻿#pragma once
+
+#include <vector>
+
+class SkeletalMesh;
+
+// Import time processing of mesh streams and indices, it doesn't touch the GL buffers
+class MeshOptimizer
+{
+public:
+    MeshOptimizer() = delete;
+    MeshOptimizer(const MeshOptimizer&) = delete;
+    MeshOptimizer& operator=(const MeshOptimizer&) = delete;
+
+    // Weld + vertex cache + vertex fetch
+    static void Optimize(SkeletalMesh& mesh);
+
+    // Merges vertices with identical attributes, non indexed meshes get an index buffer. Returns removed vertices
+    static unsigned int WeldVertices(SkeletalMesh& mesh);
+    // Reorders triangles for the post-transform vertex cache (Forsyth's linear-speed algorithm)
+    static void OptimizeVertexCache(SkeletalMesh& mesh);
+    // Reorders vertices in the order the indices first use them, so skinning and fetching walk memory linearly
+    static void OptimizeVertexFetch(SkeletalMesh& mesh);
+
+    // Average transformed vertices per triangle with a FIFO cache, lower is better (0.5 is the ideal)
+    static float GetACMR(const std::vector<unsigned int>& indices, unsigned int cacheSize = 16);
+    
+}; // MeshOptimizer
@@ -0,0 +1,17 @@
+﻿#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Core/Vec3.h"
+
+// Sparse blend shape, only the vertices the target moves are stored (sorted by vertex)
+struct MorphTarget
+{
+    std::string name;
+    std::vector<unsigned int> vertices;
+    std::vector<Vec3> positionDeltas;
+    // Empty when the target doesn't move normals
+    std::vector<Vec3> normalDeltas;
+    
+}; // MorphTarget
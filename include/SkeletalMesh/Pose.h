@@ -26,6 +26,8 @@ public:
     Transform GetGlobalTransform(unsigned int idx) const;
     Transform operator[](unsigned int idx) const;
     DualQuaternion GetGlobalDualQuaternion(unsigned int idx) const;
+    // World transform of every joint, computed in a single pass when parents come before children
+    void GetGlobalTransforms(std::vector<Transform>& out) const;
 
     void GetMatrixPalette(std::vector<Mat4>& out) const;
     void GetMatrixPreSkinnedPalette(std::vector<Mat4>& out, const Skeleton& skeleton) const;
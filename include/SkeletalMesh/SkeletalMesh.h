@@ -1,11 +1,11 @@
 ﻿#pragma once
 
-#include <map>
 #include <vector>
 
+#include "SkeletalMesh/Skeleton.h"
+
+struct MorphTarget;
 struct TriangleMesh;
-class Pose;
-class Skeleton;
 struct Mat4;
 template <typename T> class Attribute;
 struct Vec3;
@@ -15,7 +15,6 @@ typedef TVec4<float> Vec4;
 template <typename T> struct TVec2;
 typedef TVec2<float> Vec2;
 class IndexBuffer;
-typedef std::map<int, int> BoneMap;
 
 class SkeletalMesh
 {
@@ -37,6 +36,10 @@ public:
     std::vector<IVec4>& GetBonesID() { return m_BonesID; }
     const std::vector<unsigned int>& GetIndices() const { return m_Indices; }
     std::vector<unsigned int>& GetIndices() { return m_Indices; }
+    const std::vector<MorphTarget>& GetMorphTargets() const { return m_MorphTargets; }
+    std::vector<MorphTarget>& GetMorphTargets() { return m_MorphTargets; }
+    const std::vector<float>& GetDefaultMorphWeights() const { return m_DefaultMorphWeights; }
+    std::vector<float>& GetDefaultMorphWeights() { return m_DefaultMorphWeights; }
     
     void UpdateOpenGLBuffers() const; // Sync with GPU
     void Bind(int position, int normal, int texCoord, int boneWeight, int boneID) const;
@@ -47,6 +50,8 @@ public:
 
     void CPUSkin(const Skeleton& skeleton, const Pose& pose);
     void CPUSkin(const std::vector<Mat4>& animatedPose);
+    // Adds the deltas of the targets with a non zero weight before skinning, one weight per morph target
+    void CPUMorphAndSkin(const Skeleton& skeleton, const Pose& pose, const std::vector<float>& morphWeights);
 
     void RearrangeMesh(const BoneMap& boneMap);
 
@@ -54,12 +59,17 @@ public:
     void GetTriangles(std::vector<TriangleMesh>& triangles) const;
 
 protected:
+    void SkinVertices(const Skeleton& skeleton, const Pose& pose, const std::vector<Vec3>& positions,
+        const std::vector<Vec3>& normals);
+    
     std::vector<Vec3> m_Position;
     std::vector<Vec3> m_Normal;
     std::vector<Vec2> m_TexCoords;
     std::vector<Vec4> m_BonesWeight;
     std::vector<IVec4> m_BonesID;
     std::vector<unsigned int> m_Indices;
+    std::vector<MorphTarget> m_MorphTargets;
+    std::vector<float> m_DefaultMorphWeights;
     
     Attribute<Vec3>* m_PositionAttribute = nullptr;
     Attribute<Vec3>* m_NormalAttribute = nullptr;
@@ -72,5 +82,7 @@ protected:
     std::vector<Vec3> m_SkinnedPosition;
     std::vector<Vec3> m_SkinnedNormal;
     std::vector<Mat4> m_PosePalette;
+    std::vector<Vec3> m_MorphedPosition;
+    std::vector<Vec3> m_MorphedNormal;
     
 }; // SkeletalMesh
@@ -1,12 +1,12 @@
 ﻿#pragma once
 
-#include <map>
 #include <vector>
 #include <string>
 
 #include "Pose.h"
 
-typedef std::map<int, int> BoneMap;
+// Old bone ID to new bone ID, shifted by one so the -1 (no parent) sentinel maps to itself: newID = boneMap[oldID + 1]
+typedef std::vector<int> BoneMap;
 
 class Skeleton
 {
@@ -0,0 +1,204 @@
+﻿#include "Animation/AnimTextureSampler.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Animation/Clip.h"
+#include "Animation/Crowd.h"
+#include "Animation/FastTrack.h"
+#include "Animation/TransformTrack.h"
+#include "Core/BasicUtils.h"
+#include "Core/Transform.h"
+#include "Core/TVec2.h"
+#include "Render/AnimTexture.h"
+#include "SkeletalMesh/Pose.h"
+#include "SkeletalMesh/Skeleton.h"
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+namespace AnimTextureSamplerHelpers
+{
+    // Same as texelFetch, texel (x, y) is stored at (y * width + x) * 4
+    inline const float* FetchTexel(const float* data, unsigned int width, int x, unsigned int y)
+    {
+        return data + (y * width + static_cast<unsigned int>(x)) * 4;
+    }
+
+    inline Transform Interpolate(const float* data, unsigned int width, unsigned int joint, const IVec2& frames,
+        float t)
+    {
+        const unsigned int yPos = joint * 3;
+
+        // Clamped to the baked columns like the bake does, frames from a stale time can't read past the texels
+        const int lastFrame = static_cast<int>(width) - 1;
+        const int frame0 = BasicUtils::Clamp(frames.x, 0, lastFrame);
+        const int frame1 = BasicUtils::Clamp(frames.y, 0, lastFrame);
+        
+        const float* pos0 = FetchTexel(data, width, frame0, yPos + 0);
+        const float* rot0 = FetchTexel(data, width, frame0, yPos + 1);
+        const float* scl0 = FetchTexel(data, width, frame0, yPos + 2);
+        const float* pos1 = FetchTexel(data, width, frame1, yPos + 0);
+        const float* rot1 = FetchTexel(data, width, frame1, yPos + 1);
+        const float* scl1 = FetchTexel(data, width, frame1, yPos + 2);
+
+        const Quat from(rot0);
+        const Quat to = Quat::GetNeighbour(Quat(rot1), from);
+
+        return
+        {
+            Vec3::Lerp(Vec3(pos0), Vec3(pos1), t),
+            Quat::NLerp(from, to, t),
+            Vec3::Lerp(Vec3(scl0), Vec3(scl1), t)
+        };
+    }
+    
+} // AnimTextureSamplerHelpers
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+Transform AnimTextureSampler::SampleJoint(const AnimTexture& tex, unsigned joint, const IVec2& frames, float t)
+{
+    const float* data = tex.GetData();
+    const unsigned int size = tex.GetSize();
+    if (data == nullptr || joint * 3 + 2 >= size)
+    {
+        return {};
+    }
+
+    return AnimTextureSamplerHelpers::Interpolate(data, size, joint, frames, t);
+    
+} // SampleJoint
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void AnimTextureSampler::SamplePose(const AnimTexture& tex, const IVec2& frames, float t, unsigned numJoints,
+    std::vector<Transform>& outPose)
+{
+    outPose.resize(numJoints);
+    
+    const float* data = tex.GetData();
+    const unsigned int size = tex.GetSize();
+    const unsigned int numBakedJoints = data == nullptr ? 0 : std::min(numJoints, size / 3);
+    
+    for (unsigned int i = 0; i < numBakedJoints; ++i)
+    {
+        outPose[i] = AnimTextureSamplerHelpers::Interpolate(data, size, i, frames, t);
+    }
+
+    std::fill(outPose.begin() + numBakedJoints, outPose.end(), Transform());
+    
+} // SamplePose
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void AnimTextureSampler::SampleCrowd(const AnimTexture& tex, const Crowd& crowd, unsigned numJoints,
+    std::vector<Transform>& outPoses, bool bWorldSpace)
+{
+    const unsigned int numActors = crowd.GetSize();
+    outPoses.resize(numActors * numJoints);
+    
+    const float* data = tex.GetData();
+    const unsigned int size = tex.GetSize();
+    const unsigned int numBakedJoints = data == nullptr ? 0 : std::min(numJoints, size / 3);
+    
+    for (unsigned int i = 0; i < numActors; ++i)
+    {
+        const IVec2 frames = crowd.GetFrames(i);
+        const float t = crowd.GetTime(i);
+        Transform* pose = outPoses.data() + i * numJoints;
+
+        for (unsigned int j = 0; j < numBakedJoints; ++j)
+        {
+            pose[j] = AnimTextureSamplerHelpers::Interpolate(data, size, j, frames, t);
+        }
+
+        std::fill(pose + numBakedJoints, pose + numJoints, Transform());
+
+        if (bWorldSpace)
+        {
+            const Transform actor = crowd.GetActor(i);
+            for (unsigned int j = 0; j < numJoints; ++j)
+            {
+                pose[j] = actor.Combine(pose[j]);
+            }
+        }
+    }
+    
+} // SampleCrowd
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void AnimTextureSampler::GetFramesAtTime(float time, float start, float end, unsigned texWidth, IVec2& outFrames,
+    float& outT)
+{
+    const float duration = end - start;
+    const int lastFrame = static_cast<int>(texWidth) - 1;
+    if (duration <= 0.f || lastFrame <= 0)
+    {
+        outFrames = {0, 0};
+        outT = 1.f;
+        return;
+    }
+
+    const float frame = BasicUtils::Clamp((time - start) / duration, 0.f, 1.f) * static_cast<float>(lastFrame);
+    const int frameIdx = std::min(static_cast<int>(frame), lastFrame);
+    outFrames = {frameIdx, std::min(frameIdx + 1, lastFrame)};
+    
+    // Same convention as the crowd, a single frame is fully weighted
+    outT = outFrames.x == outFrames.y ? 1.f : frame - static_cast<float>(frameIdx);
+    
+} // GetFramesAtTime
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+template AnimTextureBakeError AnimTextureSampler::MeasureBakeError(const Skeleton&, const TClip<TransformTrack>&,
+    const AnimTexture&, unsigned int);
+template AnimTextureBakeError AnimTextureSampler::MeasureBakeError(const Skeleton&, const TClip<FastTransformTrack>&,
+    const AnimTexture&, unsigned int);
+
+template <typename TRACK>
+AnimTextureBakeError AnimTextureSampler::MeasureBakeError(const Skeleton& skeleton, const TClip<TRACK>& clip,
+    const AnimTexture& tex, unsigned int numSamples)
+{
+    AnimTextureBakeError result;
+    
+    const float start = clip.GetStartTime();
+    const float end = clip.GetEndTime();
+    const unsigned int texWidth = tex.GetSize();
+    
+    Pose pose = skeleton.GetBindPose();
+    std::vector<Transform> expected;
+    std::vector<Transform> baked;
+
+    // Samples between baked columns too, so the error includes the interpolation done by the shader
+    for (unsigned int s = 0; s < numSamples; ++s)
+    {
+        const float alpha = numSamples > 1 ? static_cast<float>(s) / static_cast<float>(numSamples - 1) : 0.f;
+        const float time = BasicUtils::Lerp(start, end, alpha);
+        
+        clip.Sample(pose, time);
+        pose.GetGlobalTransforms(expected);
+
+        IVec2 frames;
+        float t;
+        GetFramesAtTime(time, start, end, texWidth, frames, t);
+        SamplePose(tex, frames, t, expected.size(), baked);
+
+        const unsigned int numJoints = expected.size();
+        for (unsigned int j = 0; j < numJoints; ++j)
+        {
+            const float positionError = (expected[j].position - baked[j].position).Len();
+            const float rotationError = 1.f - fabsf(expected[j].rotation | baked[j].rotation);
+            const float scaleError = (expected[j].scale - baked[j].scale).Len();
+
+            result.maxPositionError = std::max(result.maxPositionError, positionError);
+            result.maxRotationError = std::max(result.maxRotationError, rotationError);
+            result.maxScaleError = std::max(result.maxScaleError, scaleError);
+        }
+    }
+
+    return result;
+    
+} // MeasureBakeError
+
+// ---------------------------------------------------------------------------------------------------------------------
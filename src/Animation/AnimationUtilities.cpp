@@ -1,6 +1,9 @@
 ﻿#include "Animation/AnimationUtilities.h"
 
 #include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
 
 #include "Animation/Frame.h"
 #include "Animation/FastTrack.h"
@@ -9,6 +12,7 @@
 #include "Core/BasicUtils.h"
 #include "Core/Transform.h"
 #include "Render/AnimTexture.h"
+#include "SkeletalMesh/Pose.h"
 #include "SkeletalMesh/Skeleton.h"
 
 // ---------------------------------------------------------------------------------------------------------------------
@@ -50,36 +54,107 @@ Pose AnimationUtilities::MakeAdditivePose(const Skeleton& skeleton, const TClip<
 
 // ---------------------------------------------------------------------------------------------------------------------
 
-template void AnimationUtilities::BakeAnimationToTexture(const Skeleton&, const TClip<TransformTrack>&, AnimTexture&);
-template void AnimationUtilities::BakeAnimationToTexture(const Skeleton&, const TClip<FastTransformTrack>&, AnimTexture&);
+template void AnimationUtilities::BakeAnimationToTexture(const Skeleton&, const TClip<TransformTrack>&, AnimTexture&,
+    unsigned int, AnimBakeStats*);
+template void AnimationUtilities::BakeAnimationToTexture(const Skeleton&, const TClip<FastTransformTrack>&, AnimTexture&,
+    unsigned int, AnimBakeStats*);
 
 template <typename TRACK>
-void AnimationUtilities::BakeAnimationToTexture(const Skeleton& skeleton, const TClip<TRACK>& clip, AnimTexture& outTex)
+void AnimationUtilities::BakeAnimationToTexture(const Skeleton& skeleton, const TClip<TRACK>& clip, AnimTexture& outTex,
+    unsigned int numThreads, AnimBakeStats* outStats)
 {
-    Pose pose = skeleton.GetBindPose();
+    const auto startClock = std::chrono::steady_clock::now();
     
     const unsigned int texWidth = outTex.GetSize();
-    const unsigned int numTotalChannels = pose.GetSize();
     const float start = clip.GetStartTime();
     const float end = clip.GetEndTime();
-    
-    for (unsigned int x = 0; x < texWidth; ++x)
+    float* texData = outTex.GetData();
+
+    if (numThreads == 0)
+    {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    numThreads = std::max(1u, std::min(numThreads, texWidth));
+
+    if (outStats != nullptr)
     {
-        const float alpha = static_cast<float>(x) / static_cast<float>(texWidth - 1);
-        float time = BasicUtils::Lerp(start, end, alpha);
-        clip.Sample(pose, time);
+        outStats->bakedColumns = 0;
+        outStats->totalColumns = texWidth;
+        outStats->numThreads = numThreads;
+    }
+
+    // Bakes columns [firstColumn, lastColumn), texel (x, y) is stored at (y * width + x) * 4
+    auto BakeColumns = [&](unsigned int firstColumn, unsigned int lastColumn)
+    {
+        Pose pose = skeleton.GetBindPose();
+        std::vector<Transform> worldTransforms;
+        const unsigned int rowStride = texWidth * 4;
         
-        for (unsigned int y = 0; y < numTotalChannels; ++y)
+        for (unsigned int x = firstColumn; x < lastColumn; ++x)
         {
-            const unsigned int yShift = 3 * y;
-            Transform jointTransform = pose.GetGlobalTransform(y);
-            outTex.SetTexel(x, yShift + 0, jointTransform.position);
-            outTex.SetTexel(x, yShift + 1, jointTransform.rotation);
-            outTex.SetTexel(x, yShift + 2, jointTransform.scale);
+            const float alpha = static_cast<float>(x) / static_cast<float>(texWidth - 1);
+            const float time = BasicUtils::Lerp(start, end, alpha);
+            clip.Sample(pose, time);
+            pose.GetGlobalTransforms(worldTransforms);
+
+            const unsigned int numJoints = worldTransforms.size();
+            for (unsigned int y = 0; y < numJoints; ++y)
+            {
+                const Transform& jointTransform = worldTransforms[y];
+                float* texel = texData + ((3 * y) * texWidth + x) * 4;
+
+                texel[0] = jointTransform.position.x;
+                texel[1] = jointTransform.position.y;
+                texel[2] = jointTransform.position.z;
+                texel[3] = 0.f;
+                texel += rowStride;
+
+                texel[0] = jointTransform.rotation.x;
+                texel[1] = jointTransform.rotation.y;
+                texel[2] = jointTransform.rotation.z;
+                texel[3] = jointTransform.rotation.w;
+                texel += rowStride;
+
+                texel[0] = jointTransform.scale.x;
+                texel[1] = jointTransform.scale.y;
+                texel[2] = jointTransform.scale.z;
+                texel[3] = 0.f;
+            }
+
+            if (outStats != nullptr)
+            {
+                ++outStats->bakedColumns;
+            }
         }
+    };
+
+    // Contiguous column ranges so threads only share cache lines at range boundaries
+    const unsigned int columnsPerThread = (texWidth + numThreads - 1) / numThreads;
+    std::vector<std::thread> workers;
+    workers.reserve(numThreads - 1);
+    
+    for (unsigned int i = 1; i < numThreads; ++i)
+    {
+        const unsigned int firstColumn = std::min(i * columnsPerThread, texWidth);
+        const unsigned int lastColumn = std::min(firstColumn + columnsPerThread, texWidth);
+        workers.emplace_back(BakeColumns, firstColumn, lastColumn);
+    }
+
+    // Calling thread bakes the first range
+    BakeColumns(0, std::min(columnsPerThread, texWidth));
+    
+    for (std::thread& worker : workers)
+    {
+        worker.join();
     }
 
     outTex.UploadTextureDataToGPU();
+
+    if (outStats != nullptr)
+    {
+        const std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - startClock;
+        outStats->elapsedMs = elapsed.count();
+    }
     
 } // BakeAnimationToTexture
 
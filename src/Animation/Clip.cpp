@@ -1,6 +1,7 @@
 ﻿#include "Animation/Clip.h"
 
 #include <algorithm>
+#include <iostream>
 
 #include "Animation/FastTrack.h"
 #include "Animation/Track.h"
@@ -228,7 +229,15 @@ void TClip<TRACK>::RearrangeClip(const BoneMap& boneMap)
 {
     for (TRACK& track : m_Tracks)
     {
-       track.SetID(static_cast<unsigned int>(boneMap.at(static_cast<int>(track.GetID()))));
+        const unsigned int oldIdx = track.GetID() + 1;
+        if (oldIdx >= boneMap.size())
+        {
+            std::cout << "Track of joint " << track.GetID() << " out of the bone map range in clip " << m_Name
+                << std::endl;
+            continue;
+        }
+        
+        track.SetID(static_cast<unsigned int>(boneMap[oldIdx]));
     }
 
 } // RearrangeClip
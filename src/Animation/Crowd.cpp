@@ -1,5 +1,6 @@
 ﻿#include "Animation/Crowd.h"
 
+#include <algorithm>
 #include <random>
 
 #include "Animation/Clip.h"
@@ -27,6 +28,38 @@ Transform Crowd::GetActor(unsigned idx) const
 
 // ---------------------------------------------------------------------------------------------------------------------
 
+const IVec2& Crowd::GetFrames(unsigned idx) const
+{
+    return m_Frames[idx];
+    
+} // GetFrames
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+float Crowd::GetTime(unsigned idx) const
+{
+    return m_Times[idx];
+    
+} // GetTime
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+CrowdLOD Crowd::GetLOD(unsigned idx) const
+{
+    return m_LODs[idx];
+    
+} // GetLOD
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+unsigned Crowd::GetNumUpdatedActors() const
+{
+    return m_UpdatedActors.size();
+    
+} // GetNumUpdatedActors
+
+// ---------------------------------------------------------------------------------------------------------------------
+
 void Crowd::Resize(unsigned size)
 {
     static constexpr unsigned int CROWD_MAX_ACTORS = 80;
@@ -39,6 +72,18 @@ void Crowd::Resize(unsigned size)
     m_Times.resize(size);
     m_CurrentPlayTimes.resize(size);
     m_NextPlayTimes.resize(size);
+    m_LODs.resize(size, CrowdLOD::Full);
+    m_PendingTimes.resize(size);
+    m_UpdatedActors.reserve(size);
+
+    for (unsigned int i = m_Grid.GetSize(); i > size; --i)
+    {
+        m_Grid.Remove(i - 1);
+    }
+    for (unsigned int i = m_Grid.GetSize(); i < size; ++i)
+    {
+        m_Grid.Insert(i, m_Positions[i]);
+    }
     
 } // Resize
 
@@ -49,6 +94,7 @@ void Crowd::SetActor(unsigned idx, const Transform& t)
     m_Positions[idx] = t.position;
     m_Rotations[idx] = t.rotation;
     m_Scales[idx] = t.scale;
+    m_Grid.Move(idx, t.position);
     
 } // SetActor
 
@@ -66,6 +112,37 @@ void Crowd::SetUniforms(const Shader* shader) const
 
 // ---------------------------------------------------------------------------------------------------------------------
 
+void Crowd::SetLODDistances(float halfRate, float quarterRate, float frozen)
+{
+    // Thresholds must be ascending for UpdateLODs
+    quarterRate = std::max(quarterRate, halfRate);
+    frozen = std::max(frozen, quarterRate);
+    
+    m_LODDistancesSq[0] = halfRate * halfRate;
+    m_LODDistancesSq[1] = quarterRate * quarterRate;
+    m_LODDistancesSq[2] = frozen * frozen;
+    
+} // SetLODDistances
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void Crowd::UpdateLODs(const Vec3& observer)
+{
+    const unsigned int size = m_Positions.size();
+    for (unsigned int i = 0; i < size; ++i)
+    {
+        // Branchless, the tier is the number of thresholds the actor is past
+        const float distSq = (m_Positions[i] - observer).LenSq();
+        const unsigned int lod = static_cast<unsigned int>(distSq >= m_LODDistancesSq[0]) +
+            static_cast<unsigned int>(distSq >= m_LODDistancesSq[1]) +
+            static_cast<unsigned int>(distSq >= m_LODDistancesSq[2]);
+        m_LODs[i] = static_cast<CrowdLOD>(lod);
+    }
+    
+} // UpdateLODs
+
+// ---------------------------------------------------------------------------------------------------------------------
+
 template void Crowd::Update(float, const FastClip&, unsigned);
 template void Crowd::Update(float, const Clip&, unsigned);
 
@@ -77,9 +154,12 @@ void Crowd::Update(float deltaTime, const TClip<TRACK>& clip, unsigned texWidth)
     const float end = clip.GetEndTime();
     const float duration = end - start;
 
-    UpdatePlaybackTimes(deltaTime, bLooping, start, end);
+ 
+    GatherUpdatedActors(deltaTime);
+    UpdatePlaybackTimes(bLooping, start, end);
     UpdateFrameIndices(start, duration, texWidth);
     UpdateInterpolationTimes(start, duration, texWidth);
+    ++m_FrameCounter;
     
 } // Update
 
@@ -107,51 +187,54 @@ void Crowd::RandomizeTimes(const TClip<TRACK>& clip)
 
 void Crowd::RandomizePositions(const Vec3& min, const Vec3& max, float radius)
 {
-    const unsigned int size = m_CurrentPlayTimes.size();
-    unsigned int breakLoop = 0;
+    // Dart throwing, the grid only checks candidates against actors in the surrounding cells
+    static constexpr unsigned int MAX_ATTEMPTS_PER_ACTOR = 30;
+    static std::random_device rd;  //Will be used to obtain a seed for the random number engine
+    static std::mt19937 gen(rd()); //Standard mersenne_twister_engine seeded with rd()
+    std::uniform_real_distribution<float> uniformDistX(min.x, max.x);
+    std::uniform_real_distribution<float> uniformDistY(min.y, max.y);
+    std::uniform_real_distribution<float> uniformDistZ(min.z, max.z);
+    
+    const unsigned int size = m_Positions.size();
+    const unsigned int maxFailures = size * MAX_ATTEMPTS_PER_ACTOR;
+    unsigned int numFailures = 0;
     unsigned int currentSize = 0;
+
+    m_Grid.Clear();
+    m_Grid.SetCellSize(radius);
     
-    while (currentSize < size)
+    while (currentSize < size && numFailures < maxFailures)
     {
-        static constexpr unsigned int MAX_LOOP = 2000;
-        if (breakLoop >= MAX_LOOP)
-        {
-            return;
-        }
-
-        static std::random_device rd;  //Will be used to obtain a seed for the random number engine
-        static std::mt19937 gen(rd()); //Standard mersenne_twister_engine seeded with rd()
-        const std::uniform_real_distribution<float> uniformDistX(min.x, max.x);
-        const std::uniform_real_distribution<float> uniformDistY(min.y, max.y);
-        const std::uniform_real_distribution<float> uniformDistZ(min.z, max.z);
-        
         const Vec3 newPoint = {uniformDistX(gen), uniformDistY(gen), uniformDistZ(gen)};
-        const float radiusSq = radius * radius;
-        bool bValid = true;
-        
-        for (const Vec3& pos : m_Positions)
-        {
-            if ((pos - newPoint).LenSq() < radiusSq)
-            {
-                bValid = false;
-                breakLoop += 1;
-                break;
-            }
-        }
-
-        if (!bValid)
+        if (m_Grid.AnyWithinRadius(newPoint, radius))
         {
+            ++numFailures;
             continue;
         }
 
         m_Positions[currentSize] = newPoint;
+        m_Grid.Insert(currentSize, newPoint);
         ++currentSize;
     }
+
+    // Actors that didn't fit keep their previous position
+    for (unsigned int i = currentSize; i < size; ++i)
+    {
+        m_Grid.Insert(i, m_Positions[i]);
+    }
     
 } // RandomizePositions
 
 // ---------------------------------------------------------------------------------------------------------------------
 
+void Crowd::QueryNeighbours(const Vec3& center, float radius, std::vector<unsigned>& outActors) const
+{
+    m_Grid.Query(center, radius, outActors);
+    
+} // QueryNeighbours
+
+// ---------------------------------------------------------------------------------------------------------------------
+
 float Crowd::AdjustTime(float t, float start, float end, bool bLooping)
 {
     const float duration = end - start;
@@ -176,13 +259,41 @@ float Crowd::AdjustTime(float t, float start, float end, bool bLooping)
 
 // ---------------------------------------------------------------------------------------------------------------------
 
-void Crowd::UpdatePlaybackTimes(float dt, bool bLooping, float start, float end)
+void Crowd::GatherUpdatedActors(float dt)
 {
+    m_UpdatedActors.clear();
+    
     const unsigned int size = m_CurrentPlayTimes.size();
     for (unsigned int i = 0; i < size; ++i)
     {
+        if (m_LODs[i] == CrowdLOD::Frozen)
+        {
+            m_PendingTimes[i] = 0.f;
+            continue;
+        }
+
+        // Half and quarter rate actors are staggered by index so their cost is spread across frames
+        m_PendingTimes[i] += dt;
+        const unsigned int updateRate = 1u << static_cast<unsigned int>(m_LODs[i]);
+        if ((m_FrameCounter + i) % updateRate == 0)
+        {
+            m_UpdatedActors.push_back(i);
+        }
+    }
+    
+} // GatherUpdatedActors
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void Crowd::UpdatePlaybackTimes(bool bLooping, float start, float end)
+{
+    // Skipped frames are caught up here, so reduced rate actors stay in sync with full rate ones
+    for (const unsigned int i : m_UpdatedActors)
+    {
+        const float dt = m_PendingTimes[i];
         m_CurrentPlayTimes[i] = AdjustTime(m_CurrentPlayTimes[i] + dt, start, end, bLooping);
         m_NextPlayTimes[i] = AdjustTime(m_CurrentPlayTimes[i] + dt, start, end, bLooping);
+        m_PendingTimes[i] = 0.f;
     }
     
 } // UpdatePlaybackTimes
@@ -192,9 +303,8 @@ void Crowd::UpdatePlaybackTimes(float dt, bool bLooping, float start, float end)
 void Crowd::UpdateFrameIndices(float start, float duration, unsigned textWidth)
 {
     const auto texSize = static_cast<float>(textWidth - 1);
-    const unsigned int size = m_CurrentPlayTimes.size();
     
-    for (unsigned int i = 0; i < size; ++i)
+    for (const unsigned int i : m_UpdatedActors)
     {
         const float normCurrentTime = (m_CurrentPlayTimes[i] - start) / duration;
         const float normNextTime = (m_NextPlayTimes[i] - start) / duration;
@@ -209,9 +319,8 @@ void Crowd::UpdateFrameIndices(float start, float duration, unsigned textWidth)
 void Crowd::UpdateInterpolationTimes(float start, float duration, unsigned textWidth)
 {
     const auto texSize = static_cast<float>(textWidth - 1);
-    const unsigned int size = m_CurrentPlayTimes.size();
     
-    for (unsigned int i = 0; i < size; ++i)
+    for (const unsigned int i : m_UpdatedActors)
     {
         if (m_Frames[i].x == m_Frames[i].y)
         {
@@ -11,6 +11,24 @@ template FastQuaternionTrack;
 
 // ---------------------------------------------------------------------------------------------------------------------
 
+template <typename T, unsigned N>
+const std::vector<unsigned>& FastTrack<T, N>::GetIndexLookupTable() const
+{
+    return m_SampledFrames;
+    
+} // GetIndexLookupTable
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+template <typename T, unsigned N>
+std::vector<unsigned>& FastTrack<T, N>::GetIndexLookupTable()
+{
+    return m_SampledFrames;
+    
+} // GetIndexLookupTable
+
+// ---------------------------------------------------------------------------------------------------------------------
+
 template <typename T, unsigned N>
 void FastTrack<T, N>::UpdateIndexLookupTable()
 {
@@ -0,0 +1,457 @@
+﻿#include "Animation/StreamedClip.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "Animation/Clip.h"
+#include "Animation/FastTrack.h"
+#include "Animation/TransformTrack.h"
+#include "Core/BasicUtils.h"
+#include "Core/Transform.h"
+#include "SkeletalMesh/Pose.h"
+
+static_assert(sizeof(Transform) == 10 * sizeof(float), "Streamed keys are read as raw transforms");
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+template bool StreamedClip::Write(const char*, const TClip<TransformTrack>&, const Pose&, float, float);
+template bool StreamedClip::Write(const char*, const TClip<FastTransformTrack>&, const Pose&, float, float);
+
+template <typename TRACK>
+bool StreamedClip::Write(const char* path, const TClip<TRACK>& clip, const Pose& restPose, float sampleRate,
+    float blockDuration)
+{
+    // Sampled without looping so the last frame lands on the end time instead of wrapping to the start
+    TClip<TRACK> sampledClip = clip;
+    sampledClip.SetLooping(false);
+    
+    const float duration = clip.GetDuration();
+    const unsigned int numJoints = clip.GetSize();
+    const unsigned int numFrames = std::max(2u, static_cast<unsigned int>(ceilf(duration * sampleRate)) + 1);
+    const unsigned int framesPerBlock = std::max(1u, static_cast<unsigned int>(roundf(blockDuration * sampleRate)));
+    const unsigned int numBlocks = (numFrames - 2) / framesPerBlock + 1;
+    const float frameStep = duration / static_cast<float>(numFrames - 1);
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        std::cout << "Couldn't open " << path << std::endl;
+        return false;
+    }
+
+    const std::string& name = clip.GetName();
+    StreamedClipHeader header = {};
+    header.magic = STREAMED_CLIP_MAGIC;
+    header.version = STREAMED_CLIP_VERSION;
+    header.numJoints = numJoints;
+    header.numFrames = numFrames;
+    header.framesPerBlock = framesPerBlock;
+    header.numBlocks = numBlocks;
+    header.startTime = clip.GetStartTime();
+    header.endTime = clip.GetEndTime();
+    header.bLooping = clip.IsLooping() ? 1 : 0;
+    header.nameLength = name.size();
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(name.data(), name.size());
+
+    std::vector<uint32_t> jointIDs(numJoints);
+    for (unsigned int i = 0; i < numJoints; ++i)
+    {
+        jointIDs[i] = clip.GetIDAtIndex(i);
+    }
+    file.write(reinterpret_cast<const char*>(jointIDs.data()), numJoints * sizeof(uint32_t));
+
+    // Blocks are written one at a time so cooking a long take doesn't need it resident either
+    Pose pose = restPose;
+    std::vector<Transform> keys((framesPerBlock + 1) * numJoints);
+    for (unsigned int b = 0; b < numBlocks; ++b)
+    {
+        for (unsigned int k = 0; k <= framesPerBlock; ++k)
+        {
+            const unsigned int frame = std::min(b * framesPerBlock + k, numFrames - 1);
+            sampledClip.Sample(pose, clip.GetStartTime() + static_cast<float>(frame) * frameStep);
+            
+            for (unsigned int j = 0; j < numJoints; ++j)
+            {
+                keys[k * numJoints + j] = pose.GetLocalTransform(jointIDs[j]);
+            }
+        }
+        file.write(reinterpret_cast<const char*>(keys.data()), keys.size() * sizeof(Transform));
+    }
+
+    if (!file)
+    {
+        std::cout << "Couldn't write " << path << std::endl;
+        return false;
+    }
+
+    return true;
+    
+} // Write
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+StreamedClip::StreamedClip()
+{
+    
+} // StreamedClip
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+StreamedClip::~StreamedClip()
+{
+    Close();
+    
+} // ~StreamedClip
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+bool StreamedClip::Open(const char* path, unsigned int numResidentBlocks)
+{
+    Close();
+
+    m_File.open(path, std::ios::binary);
+    if (!m_File)
+    {
+        std::cout << "Couldn't open " << path << std::endl;
+        return false;
+    }
+
+    StreamedClipHeader header = {};
+    m_File.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!m_File || header.magic != STREAMED_CLIP_MAGIC || header.version != STREAMED_CLIP_VERSION ||
+        header.numFrames < 2 || header.framesPerBlock == 0 || header.numBlocks == 0)
+    {
+        std::cout << "Invalid streamed clip: " << path << std::endl;
+        m_File.close();
+        return false;
+    }
+
+    m_Name.resize(header.nameLength);
+    m_File.read(&m_Name[0], header.nameLength);
+    m_JointIDs.resize(header.numJoints);
+    m_File.read(reinterpret_cast<char*>(m_JointIDs.data()), header.numJoints * sizeof(uint32_t));
+    if (!m_File)
+    {
+        std::cout << "Invalid streamed clip: " << path << std::endl;
+        m_File.close();
+        return false;
+    }
+
+    m_StartTime = header.startTime;
+    m_EndTime = header.endTime;
+    m_NumFrames = header.numFrames;
+    m_FramesPerBlock = header.framesPerBlock;
+    m_NumBlocks = header.numBlocks;
+    m_FrameStep = GetDuration() / static_cast<float>(m_NumFrames - 1);
+    m_bLooping = header.bLooping != 0;
+    m_BlocksOffset = m_File.tellg();
+
+    m_Blocks.resize(std::max(1u, std::min(numResidentBlocks, m_NumBlocks)));
+    m_CurrentBlock = 0;
+    m_NumStalls = 0;
+    m_bStopLoader = false;
+    m_Loader = std::thread(&StreamedClip::LoaderLoop, this);
+    RequestPrefetch(0);
+    
+    return true;
+    
+} // Open
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void StreamedClip::Close()
+{
+    if (m_Loader.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_BlocksMutex);
+            m_bStopLoader = true;
+            m_PrefetchQueue.clear();
+        }
+        m_LoaderCondition.notify_one();
+        m_Loader.join();
+    }
+
+    m_Blocks.clear();
+    m_JointIDs.clear();
+    m_NumBlocks = 0;
+    if (m_File.is_open())
+    {
+        m_File.close();
+    }
+    
+} // Close
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+std::size_t StreamedClip::GetBlockSize() const
+{
+    return (m_FramesPerBlock + 1) * m_JointIDs.size() * sizeof(Transform);
+    
+} // GetBlockSize
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+float StreamedClip::Sample(Pose& outPose, float t) const
+{
+    if (!IsOpen() || BasicUtils::IsZero(GetDuration()))
+    {
+        return 0.f;
+    }
+
+    t = AdjustTimeToFitRange(t);
+
+    const float framePosition = (t - m_StartTime) / m_FrameStep;
+    const unsigned int frame = std::min(static_cast<unsigned int>(std::max(framePosition, 0.f)), m_NumFrames - 2);
+    const float alpha = BasicUtils::Clamp(framePosition - static_cast<float>(frame), 0.f, 1.f);
+    const unsigned int blockIdx = frame / m_FramesPerBlock;
+    const unsigned int localFrame = frame % m_FramesPerBlock;
+    const unsigned int numJoints = m_JointIDs.size();
+
+    auto WritePose = [&](const std::vector<Transform>& keys)
+    {
+        const Transform* from = &keys[localFrame * numJoints];
+        const Transform* to = from + numJoints;
+        for (unsigned int j = 0; j < numJoints; ++j)
+        {
+            outPose.SetLocalTransform(m_JointIDs[j], Transform::Mix(from[j], to[j], alpha));
+        }
+    };
+
+    bool bStalled = false;
+    {
+        std::lock_guard<std::mutex> lock(m_BlocksMutex);
+        m_CurrentBlock = blockIdx;
+        
+        const int slot = FindBlock(blockIdx);
+        if (slot >= 0)
+        {
+            WritePose(m_Blocks[slot].keys);
+        }
+        else
+        {
+            ++m_NumStalls;
+            bStalled = true;
+        }
+    }
+
+    if (bStalled)
+    {
+        // The prefetch didn't make it, read it here. Same as the loader, the disk read happens outside the lock and
+        // the block is swapped in afterwards
+        std::vector<Transform> keys;
+        if (!ReadBlock(blockIdx, keys))
+        {
+            return t;
+        }
+
+        WritePose(keys);
+
+        std::lock_guard<std::mutex> lock(m_BlocksMutex);
+        if (FindBlock(blockIdx) < 0)
+        {
+            Block& block = m_Blocks[FindSlotToEvict()];
+            block.index = static_cast<int>(blockIdx);
+            block.keys.swap(keys);
+        }
+    }
+
+    RequestPrefetch(blockIdx);
+    return t;
+    
+} // Sample
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+float StreamedClip::AdjustTimeToFitRange(float t) const
+{
+    const float duration = GetDuration();
+    if (duration <= 0.f)
+    {
+        return 0.f;
+    }
+    
+    if (m_bLooping)
+    {
+        t = fmodf(t - m_StartTime, duration);
+        t += t >= 0.f ? m_StartTime : m_EndTime;
+    }
+    else
+    {
+        t = BasicUtils::Clamp(t, m_StartTime, m_EndTime);
+    }
+
+    return t;
+    
+} // AdjustTimeToFitRange
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+bool StreamedClip::ReadBlock(unsigned blockIdx, std::vector<Transform>& outKeys) const
+{
+    const std::size_t blockSize = GetBlockSize();
+    outKeys.resize((m_FramesPerBlock + 1) * m_JointIDs.size());
+
+    std::lock_guard<std::mutex> lock(m_FileMutex);
+    m_File.clear();
+    m_File.seekg(m_BlocksOffset + static_cast<std::streamoff>(blockIdx * blockSize));
+    m_File.read(reinterpret_cast<char*>(outKeys.data()), blockSize);
+    if (!m_File)
+    {
+        std::cout << "Couldn't read block " << blockIdx << " of streamed clip " << m_Name << std::endl;
+        return false;
+    }
+
+    return true;
+    
+} // ReadBlock
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+int StreamedClip::FindBlock(unsigned blockIdx) const
+{
+    const unsigned int numSlots = m_Blocks.size();
+    for (unsigned int i = 0; i < numSlots; ++i)
+    {
+        if (m_Blocks[i].index == static_cast<int>(blockIdx))
+        {
+            return static_cast<int>(i);
+        }
+    }
+
+    return -1;
+    
+} // FindBlock
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+unsigned StreamedClip::FindSlotToEvict() const
+{
+    // Empty slots first, then the block furthest ahead of the playhead
+    unsigned int result = 0;
+    unsigned int maxDistance = 0;
+    
+    const unsigned int numSlots = m_Blocks.size();
+    for (unsigned int i = 0; i < numSlots; ++i)
+    {
+        const int index = m_Blocks[i].index;
+        if (index < 0)
+        {
+            return i;
+        }
+
+        const unsigned int distance = GetBlocksAhead(static_cast<unsigned int>(index));
+        if (distance > maxDistance)
+        {
+            maxDistance = distance;
+            result = i;
+        }
+    }
+
+    return result;
+    
+} // FindSlotToEvict
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+unsigned StreamedClip::GetBlocksAhead(unsigned block) const
+{
+    if (block >= m_CurrentBlock)
+    {
+        return block - m_CurrentBlock;
+    }
+
+    // Blocks behind the playhead are the next ones when looping, otherwise they're never used again
+    return m_bLooping ? block + m_NumBlocks - m_CurrentBlock : m_NumBlocks + m_CurrentBlock - block;
+    
+} // GetBlocksAhead
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void StreamedClip::RequestPrefetch(unsigned currentBlock) const
+{
+    bool bRequested = false;
+    {
+        std::lock_guard<std::mutex> lock(m_BlocksMutex);
+        const unsigned int window = m_Blocks.size();
+        for (unsigned int k = 1; k < window; ++k)
+        {
+            unsigned int block = currentBlock + k;
+            if (block >= m_NumBlocks)
+            {
+                if (!m_bLooping)
+                {
+                    break;
+                }
+                block -= m_NumBlocks;
+            }
+
+            const bool bQueued = std::find(m_PrefetchQueue.begin(), m_PrefetchQueue.end(), block) !=
+                m_PrefetchQueue.end();
+            if (!bQueued && FindBlock(block) < 0)
+            {
+                m_PrefetchQueue.push_back(block);
+                bRequested = true;
+            }
+        }
+    }
+
+    if (bRequested)
+    {
+        m_LoaderCondition.notify_one();
+    }
+    
+} // RequestPrefetch
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void StreamedClip::LoaderLoop()
+{
+    std::vector<Transform> keys;
+    while (true)
+    {
+        unsigned int blockIdx;
+        {
+            std::unique_lock<std::mutex> lock(m_BlocksMutex);
+            m_LoaderCondition.wait(lock, [this]() { return m_bStopLoader || !m_PrefetchQueue.empty(); });
+            if (m_bStopLoader)
+            {
+                return;
+            }
+
+            blockIdx = m_PrefetchQueue.front();
+            m_PrefetchQueue.erase(m_PrefetchQueue.begin());
+            
+            // The playhead may have moved past the window since the request
+            if (FindBlock(blockIdx) >= 0 || GetBlocksAhead(blockIdx) >= m_Blocks.size())
+            {
+                continue;
+            }
+        }
+
+        // The read happens outside the lock so sampling the resident blocks isn't blocked by the disk
+        if (!ReadBlock(blockIdx, keys))
+        {
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(m_BlocksMutex);
+        if (FindBlock(blockIdx) >= 0)
+        {
+            continue;
+        }
+
+        // Never replace a block the playhead needs sooner
+        Block& block = m_Blocks[FindSlotToEvict()];
+        if (block.index < 0 || GetBlocksAhead(static_cast<unsigned int>(block.index)) > GetBlocksAhead(blockIdx))
+        {
+            block.index = static_cast<int>(blockIdx);
+            block.keys.swap(keys);
+        }
+    }
+    
+} // LoaderLoop
+
+// ---------------------------------------------------------------------------------------------------------------------
@@ -1,5 +1,7 @@
 ﻿#include "Application/CCDIKApp.h"
 
+#include <iostream>
+
 #include "Animation/Frame.h"
 #include "Core/BasicUtils.h"
 #include "Core/Mat4.h"
@@ -12,6 +14,7 @@ void CCDIKApp::Initialize()
     Application::Initialize();
 
     m_Solver.Resize(6);
+    m_Solver.SetWarmStart(true);
     m_Solver[0] = Transform(Vec3(), Quat::CreateFromAxis(BasicUtils::DegToRad(90.f), Vec3(1, 0, 0)), Vec3(1, 1, 1));
     m_Solver[1] = Transform(Vec3(0, 0, 1.0f), {}, Vec3(1, 1, 1));
     m_Solver[2] = Transform(Vec3(0, 0, 1.5f), {}, Vec3(1, 1, 1));
@@ -109,6 +112,10 @@ void CCDIKApp::Render(float inAspectRatio)
 
 void CCDIKApp::Shutdown()
 {
+    const IKSolverStats& stats = m_Solver.GetStats();
+    std::cout << "CCD: " << stats.numSolves << " solves, " << stats.GetAverageIterations()
+        << " iterations on average, " << stats.numEarlyOuts << " early outs" << std::endl;
+
     delete m_SolverLines;
     delete m_SolverPoints;
     delete mTargetVisual[0];
@@ -10,11 +10,12 @@
 #include "Core/BasicUtils.h"
 #include "Core/Mat4.h"
 #include "glad/glad.h"
+#include "GLTF/ClipCatalog.h"
 #include "GLTF/GLTFLoader.h"
 #include "IK/IKLeg.h"
-#include "Physics/PhysicsLibrary.h"
 #include "Physics/Ray.h"
 #include "Render/DebugDrawer.h"
+#include "Render/IKLegVisualizer.h"
 #include "Render/Shader.h"
 #include "Render/Texture.h"
 #include "Render/Uniform.h"
@@ -38,8 +39,9 @@ void CharacterIKApp::Initialize()
     cgltf_data* character_data = GLTFLoader::LoadGLTFFile("Assets/Woman.gltf");
     m_CharacterMeshes = GLTFLoader::LoadSkeletalMeshes(character_data);
     m_Skeleton = GLTFLoader::LoadSkeleton(character_data);
-    const std::vector<Clip> clips = GLTFLoader::LoadAnimationClips(character_data);
-    GLTFLoader::FreeGLTFFile(character_data);
+
+    // Only the clip that's played gets decoded, the catalog frees the file when it goes out of scope
+    ClipCatalog clipCatalog(character_data);
 
 	const BoneMap boneMap = m_Skeleton.RearrangeSkeleton();
 	for (SkeletalMesh& mesh : m_CharacterMeshes)
@@ -88,15 +90,29 @@ void CharacterIKApp::Initialize()
     m_CurrentPoseVisual = new DebugDrawer();
     m_CurrentPoseVisual->FromPose(m_CurrentPose);
     m_CurrentPoseVisual->UpdateOpenGLBuffers();
+    m_LeftLegVisual = new IKLegVisualizer();
+    m_RightLegVisual = new IKLegVisualizer();
 
     // Animations: [Running, Jump2, PickUp, SitIdle, Idle, Punch, Sitting, Walking, Jump, Lean_Left]
-    for (const Clip& clip : clips)
+    int walkingIdx = clipCatalog.FindClip("Walking");
+    if (walkingIdx < 0)
     {
-    	FastClip optimizedClip = AnimationUtilities::OptimizeClip(clip);
-    	optimizedClip.RearrangeClip(boneMap);
-    	m_Clips.emplace_back(optimizedClip);
+        std::cout << "No Walking clip in Assets/Woman.gltf, playing the first clip" << std::endl;
+        walkingIdx = 0;
     }
-    m_CurrentClipIdx = 7; // Walking
+
+    if (clipCatalog.GetNumClips() > 0)
+    {
+        FastClip optimizedClip = AnimationUtilities::OptimizeClip(clipCatalog.GetClip(walkingIdx));
+        optimizedClip.RearrangeClip(boneMap);
+        m_Clips.emplace_back(optimizedClip);
+    }
+    else
+    {
+        std::cout << "No clips in Assets/Woman.gltf" << std::endl;
+        m_Clips.emplace_back(FastClip());
+    }
+    m_CurrentClipIdx = 0;
 
     // Create moving track
     m_MotionTrack.Resize(5);
@@ -128,20 +144,20 @@ void CharacterIKApp::Initialize()
     GLTFLoader::FreeGLTFFile(environmentData);
 
     m_EnvironmentTexture = new Texture("Assets/uv.png");
+    std::vector<TriangleMesh> environmentTriangles;
     for (const SkeletalMesh& mesh : m_EnvironmentMeshes)
     {
-        mesh.GetTriangles(m_EnvironmentTriangles);
+        mesh.GetTriangles(environmentTriangles);
     }
+    m_GroundProbe.Build(environmentTriangles);
 
     // Start the character clamped to the ground. Move down a little bit so it's not perfectly up
     AdjustCharacterToGround();
     m_LastHeight = m_Model.position.y;
 
-    // Init IK
-    const Vec3 worldLeftAnkle = m_Model.Combine(m_CurrentPose.GetGlobalTransform(m_LeftLeg->GetAnkleIdx())).position;
-    const Vec3 worldRightAnkle = m_Model.Combine(m_CurrentPose.GetGlobalTransform(m_RightLeg->GetAnkleIdx())).position;
-    m_LeftLeg->SolveForLeg(m_Model, m_CurrentPose, worldLeftAnkle);
-    m_RightLeg->SolveForLeg(m_Model, m_CurrentPose, worldRightAnkle);
+    // Init IK visuals
+    m_LeftLegVisual->FromPose(*m_LeftLeg, m_Model, m_CurrentPose);
+    m_RightLegVisual->FromPose(*m_RightLeg, m_Model, m_CurrentPose);
     
     // Create shaders
     m_StaticShader = new Shader("Shaders/static.vert", "Shaders/lit.frag");
@@ -212,45 +228,41 @@ void CharacterIKApp::Update(float inDeltaTime)
 	Vec3 predictiveLeftAnkle = worldLeftAnkle;
 	Vec3 predictiveRightAnkle = worldRightAnkle;
 
-	static const Vec3 UP_OFFSET = {0, 2, 0};
-	const Ray leftAnkleRay = {worldLeftAnkle + UP_OFFSET};
-	const Ray rightAnkleRay = {worldRightAnkle + UP_OFFSET};
-
 	// Perform some raycasts for the feet, these are done in world space and
 	// will define the IK based target points. For each ankle, we need to know
 	// the current position (raycast from knee height to the sole of the foot height)
 	// and the predictive position (infinite ray cast). The target point will be
-	// between these two goals
+	// between these two goals. All the ankle rays go through the ground probe together
+	static const Vec3 UP_OFFSET = {0, 2, 0};
+	m_GroundProbe.ClearRays();
+	const unsigned int leftAnkleProbe = m_GroundProbe.AddRay({worldLeftAnkle + UP_OFFSET});
+	const unsigned int rightAnkleProbe = m_GroundProbe.AddRay({worldRightAnkle + UP_OFFSET});
+	m_GroundProbe.Resolve();
+	
 	Vec3 groundReference = m_Model.position;
-	auto CheckPredictiveAnklePos = [&](const TriangleMesh& triangle, const Ray& ankleRay, Vec3& currentAnklePos,
-		Vec3& predictiveAnklePos)
+	auto CheckPredictiveAnklePos = [&](unsigned int probe, Vec3& currentAnklePos, Vec3& predictiveAnklePos)
 	{
-		Vec3 hitPoint;
-		if (!PhysicsLibrary::RaycastTriangle(ankleRay, triangle, hitPoint))
+		const GroundProbeHit& hit = m_GroundProbe.GetHit(probe);
+		if (!hit.bHit)
 		{
 			return;
 		}
 
 		static constexpr float RAY_HEIGHT = 2.1f;
-		static constexpr float RAY_HEIGHT_SQR = RAY_HEIGHT * RAY_HEIGHT;
-		
-		if ((hitPoint - ankleRay.origin).LenSq() < RAY_HEIGHT_SQR)
+		if (hit.distance < RAY_HEIGHT)
 		{
-			currentAnklePos = hitPoint;
-			if (hitPoint.y < groundReference.y)
+			currentAnklePos = hit.point;
+			if (hit.point.y < groundReference.y)
 			{
-				groundReference = hitPoint - Vec3{0, m_SinkIntoGround, 0.f};
+				groundReference = hit.point - Vec3{0, m_SinkIntoGround, 0.f};
 			}
 		}
 		
-		predictiveAnklePos = hitPoint;
+		predictiveAnklePos = hit.point;
 	};
 	
-	for (const TriangleMesh& triangle : m_EnvironmentTriangles)
-	{
-		CheckPredictiveAnklePos(triangle, leftAnkleRay, worldLeftAnkle, predictiveLeftAnkle);
-		CheckPredictiveAnklePos(triangle, rightAnkleRay, worldRightAnkle, predictiveRightAnkle);
-	}
+	CheckPredictiveAnklePos(leftAnkleProbe, worldLeftAnkle, predictiveLeftAnkle);
+	CheckPredictiveAnklePos(rightAnkleProbe, worldRightAnkle, predictiveRightAnkle);
 
 	// Lerp the Y position of the mode over a small period of time avoiding popping
 	m_Model.position.y = m_LastHeight;
@@ -264,40 +276,49 @@ void CharacterIKApp::Update(float inDeltaTime)
 	worldRightAnkle = Vec3::Lerp(worldRightAnkle, predictiveRightAnkle, rightMotion);
 
 	// Now that we know the position of the model, as well as the ankle we can solve the feet.
-	m_LeftLeg->SolveForLeg(m_Model, m_CurrentPose, worldLeftAnkle/*, worldLeftToe*/);
-	m_RightLeg->SolveForLeg(m_Model, m_CurrentPose, worldRightAnkle/*, worldRightToe*/);
-	// Apply the solved feet
-	Pose::Blend(m_CurrentPose, m_CurrentPose, m_LeftLeg->GetPose(), 1, m_LeftLeg->GetHipIdx());
-	Pose::Blend(m_CurrentPose, m_CurrentPose, m_RightLeg->GetPose(), 1, m_RightLeg->GetHipIdx());
-
-	// Fix toes
-	auto FixToe = [&, this](IKLeg* leg, float motion)
+	// Both legs go in one batch that writes the solved hips and knees straight into the current pose
+	m_IKBatch.Clear();
+	m_LeftLeg->AddToBatch(m_IKBatch, m_Model, m_CurrentPose, worldLeftAnkle/*, worldLeftToe*/);
+	m_RightLeg->AddToBatch(m_IKBatch, m_Model, m_CurrentPose, worldRightAnkle/*, worldRightToe*/);
+	m_IKBatch.Solve();
+	if (bShowIKPose)
+	{
+		m_LeftLegVisual->FromPose(*m_LeftLeg, m_Model, m_CurrentPose);
+		m_RightLegVisual->FromPose(*m_RightLeg, m_Model, m_CurrentPose);
+	}
+
+	// Fix toes, their rays start from the solved ankles so they go through the ground probe in a second pass
+	const Vec3 directionOffset = characterForward * m_ToeLength + Vec3{0, 1, 0};
+	auto AddToeRay = [&, this](IKLeg* leg)
+	{
+		const Vec3 ankleWorldPos = m_Model.Combine(m_CurrentPose.GetGlobalTransform(leg->GetAnkleIdx())).position;
+		const Vec3 toeWorldPos = m_Model.Combine(m_CurrentPose.GetGlobalTransform(leg->GetToeIdx())).position;
+		return m_GroundProbe.AddRay({Vec3{ankleWorldPos.x, toeWorldPos.y, ankleWorldPos.z} + directionOffset});
+	};
+
+	m_GroundProbe.ClearRays();
+	const unsigned int leftToeProbe = AddToeRay(m_LeftLeg);
+	const unsigned int rightToeProbe = AddToeRay(m_RightLeg);
+	m_GroundProbe.Resolve();
+	
+	auto FixToe = [&, this](IKLeg* leg, unsigned int toeProbe, float motion)
 	{
 		const Transform ankleWorld = m_Model.Combine(m_CurrentPose.GetGlobalTransform(leg->GetAnkleIdx()));
 		const Vec3 toeWorldPos = m_Model.Combine(m_CurrentPose.GetGlobalTransform(leg->GetToeIdx())).position;
 
 		Vec3 toeTarget = toeWorldPos;
 		Vec3 toePredictive = toeWorldPos;
-		
-		const Vec3 directionOffset = characterForward * m_ToeLength + Vec3{0, 1, 0};
-		const Ray toeRay = {Vec3{ankleWorld.position.x, toeWorldPos.y, ankleWorld.position.z} + directionOffset};
 
 		// Next, see if the toes hit anything
-		for (const TriangleMesh& triangle : m_EnvironmentTriangles)
+		const GroundProbeHit& hit = m_GroundProbe.GetHit(toeProbe);
+		if (hit.bHit)
 		{
-			Vec3 hitPoint;
-			if (!PhysicsLibrary::RaycastTriangle(toeRay, triangle, hitPoint))
-			{
-				continue;
-			}
-
 			static constexpr float ANKLE_RAY_HEIGHT = 1.1f;
-			static constexpr float ANKLE_RAY_HEIGHT_SQ = ANKLE_RAY_HEIGHT * ANKLE_RAY_HEIGHT;
-			if ((hitPoint - toeRay.origin).LenSq() < ANKLE_RAY_HEIGHT_SQ)
+			if (hit.distance < ANKLE_RAY_HEIGHT)
 			{
-				toeTarget = hitPoint;
+				toeTarget = hit.point;
 			}
-			toePredictive = hitPoint;
+			toePredictive = hit.point;
 		}
 
 		// Retarget toe target and adjust ankle rotation
@@ -319,8 +340,8 @@ void CharacterIKApp::Update(float inDeltaTime)
 		m_CurrentPose.SetLocalTransform(leg->GetAnkleIdx(), ankleLocal);
 	};
 	
-	FixToe(m_LeftLeg, leftMotion);
-	FixToe(m_RightLeg, rightMotion);
+	FixToe(m_LeftLeg, leftToeProbe, leftMotion);
+	FixToe(m_RightLeg, rightToeProbe, rightMotion);
 
     m_CurrentPose.GetMatrixPreSkinnedPalette(m_PreSkinnedPalette, m_Skeleton);
     
@@ -400,8 +421,8 @@ void CharacterIKApp::Render(float inAspectRatio)
 
     if (bShowIKPose)
     {
-        m_LeftLeg->Draw(vp, {1, 0, 0});
-        m_RightLeg->Draw(vp, {0, 1, 0});
+        m_LeftLegVisual->Draw(vp, {1, 0, 0});
+        m_RightLegVisual->Draw(vp, {0, 1, 0});
     }
 
     if (!bDepthTest)
@@ -422,6 +443,8 @@ void CharacterIKApp::Shutdown()
     delete m_EnvironmentTexture;
     delete m_LeftLeg;
     delete m_RightLeg;
+    delete m_LeftLegVisual;
+    delete m_RightLegVisual;
 
     m_Clips.clear();
     m_CharacterMeshes.clear();
@@ -436,15 +459,10 @@ void CharacterIKApp::Shutdown()
 void CharacterIKApp::AdjustCharacterToGround()
 {
     const Ray groundRay = {Vec3{m_Model.position.x, 11.f, m_Model.position.z}};
-    Vec3 hitPoint;
-    
-    for (const TriangleMesh& triangle : m_EnvironmentTriangles)
+    GroundProbeHit hit;
+    if (m_GroundProbe.Raycast(groundRay, hit))
     {
-        if (PhysicsLibrary::RaycastTriangle(groundRay, triangle, hitPoint))
-        {
-            m_Model.position = hitPoint - Vec3{0.f, m_SinkIntoGround, 0.f};
-            break;
-        }
+        m_Model.position = hit.point - Vec3{0.f, m_SinkIntoGround, 0.f};
     }
     
 } // AdjustCharacterToGround
@@ -1,16 +1,15 @@
 ﻿#include "Application/CrowdApp.h"
 
-#include <io.h> 
-#define access _access_s
-
+#include <chrono>
 #include <iostream>
 
 #include "Animation/AnimationUtilities.h"
+#include "Animation/AnimTextureSampler.h"
 #include "Animation/Clip.h"
 #include "Animation/Crowd.h"
 #include "Core/Mat4.h"
 #include "Core/Vec3.h"
-#include "GLTF/GLTFLoader.h"
+#include "GLTF/AssetCache.h"
 #include "Render/AnimTexture.h"
 #include "Render/Shader.h"
 #include "Render/Texture.h"
@@ -23,6 +22,10 @@
 
 // ---------------------------------------------------------------------------------------------------------------------
 
+static const Vec3 CAMERA_POSITION = {0, 15, 40};
+
+// ---------------------------------------------------------------------------------------------------------------------
+
 CrowdApp::CrowdApp() : Application()
 {
     
@@ -35,25 +38,21 @@ void CrowdApp::Initialize()
 {
     Application::Initialize();
 
-    cgltf_data* gltf = GLTFLoader::LoadGLTFFile("Assets/Woman.gltf");
-    m_Meshes = GLTFLoader::LoadSkeletalMeshes(gltf);
-    m_Skeleton = GLTFLoader::LoadSkeleton(gltf);
-    const std::vector<Clip> clips = GLTFLoader::LoadAnimationClips(gltf);
-    GLTFLoader::FreeGLTFFile(gltf);
-
-    const BoneMap boneMap = m_Skeleton.RearrangeSkeleton();
-    for (SkeletalMesh& mesh : m_Meshes)
+    // Cooked cache holds the rearranged skeleton, meshes and optimized clips, it's rebuilt if the glTF changes
+    const auto loadStart = std::chrono::steady_clock::now();
+    CookedAsset asset;
+    if (!AssetCache::LoadOrCook("Assets/Woman.gltf", asset))
     {
-        mesh.RearrangeMesh(boneMap);
+        return;
     }
     
+    const std::chrono::duration<float, std::milli> loadTime = std::chrono::steady_clock::now() - loadStart;
+    std::cout << "Loaded Woman.gltf in " << loadTime.count() << " ms" << std::endl;
+    
     // Animations: [Running, Jump2, PickUp, SitIdle, Idle, Punch, Sitting, Walking, Jump, Lean_Left]
-    for (const Clip& clip : clips)
-    {
-        FastClip optimizedClip = AnimationUtilities::OptimizeClip(clip);
-        optimizedClip.RearrangeClip(boneMap);
-        m_Clips.emplace_back(optimizedClip);
-    }
+    m_Meshes = std::move(asset.meshes);
+    m_Skeleton = asset.skeleton;
+    m_Clips = std::move(asset.clips);
 
     m_CrowdShader = new Shader("Shaders/crowd.vert", "Shaders/lit.frag");
     m_DiffuseTexture = new Texture("Assets/Woman.png");
@@ -67,16 +66,23 @@ void CrowdApp::Initialize()
         std::string fileName = "Assets/";
         fileName += m_Clips[i].GetName();
         fileName += ".animTex";
-        const bool fileExists = access(fileName.c_str(), 0) == 0;
 
-        if (fileExists)
-        {
-            m_AnimTextures[i].Load(fileName.c_str());
-        }
-        else
+        // Missing, outdated or corrupted files are baked again
+        if (!m_AnimTextures[i].Load(fileName.c_str()))
         {
+            AnimBakeStats bakeStats;
             m_AnimTextures[i].Resize(512);
-            AnimationUtilities::BakeAnimationToTexture(m_Skeleton, m_Clips[i], m_AnimTextures[i]);
+            AnimationUtilities::BakeAnimationToTexture(m_Skeleton, m_Clips[i], m_AnimTextures[i], 0, &bakeStats);
+            std::cout << "Baked " << m_Clips[i].GetName() << " (" << bakeStats.totalColumns << " frames, "
+                << bakeStats.numThreads << " threads) in " << bakeStats.elapsedMs << " ms" << std::endl;
+
+            if (bMeasureBakeError)
+            {
+                const AnimTextureBakeError bakeError = AnimTextureSampler::MeasureBakeError(m_Skeleton,
+                    m_Clips[i], m_AnimTextures[i], 1024);
+                std::cout << "    Max error: position " << bakeError.maxPositionError << ", rotation "
+                    << bakeError.maxRotationError << ", scale " << bakeError.maxScaleError << std::endl;
+            }
             m_AnimTextures[i].Save(fileName.c_str());
         }
     }
@@ -94,6 +100,7 @@ void CrowdApp::Update(float deltaTime)
     const unsigned int numCrowds = m_Crowds.size();
     for (unsigned int i = 0; i < numCrowds; ++i)
     {
+        m_Crowds[i].UpdateLODs(CAMERA_POSITION);
         m_Crowds[i].Update(deltaTime, m_Clips[i], m_AnimTextures[i].GetSize());
     }
     
@@ -106,7 +113,7 @@ void CrowdApp::Render(float inAspectRatio)
     Application::Render(inAspectRatio);
 
     const Mat4 projection = Mat4::CreatePerspective(60.0f, inAspectRatio, 0.01f, 1000.0f);
-    static const Mat4 VIEW = Mat4::CreateLookAt(Vec3{0, 15, 40}, Vec3{0, 3, 0}, Vec3{0, 1, 0});
+    static const Mat4 VIEW = Mat4::CreateLookAt(CAMERA_POSITION, Vec3{0, 3, 0}, Vec3{0, 1, 0});
 
     m_CrowdShader->Bind();
     Uniform<Mat4>::Set(m_CrowdShader->GetUniform("view"), VIEW);
@@ -0,0 +1,142 @@
+﻿#include "Core/MappedFile.h"
+
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+MappedFile::MappedFile()
+{
+    
+} // MappedFile
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+MappedFile::MappedFile(const char* path)
+{
+    Open(path);
+    
+} // MappedFile
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+MappedFile::~MappedFile()
+{
+    Close();
+    
+} // ~MappedFile
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+bool MappedFile::Open(const char* path)
+{
+    Close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        std::cout << "Couldn't open " << path << std::endl;
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(file);
+        std::cout << "Couldn't map empty file " << path << std::endl;
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr)
+    {
+        CloseHandle(file);
+        std::cout << "Couldn't map " << path << std::endl;
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        std::cout << "Couldn't map " << path << std::endl;
+        return false;
+    }
+
+    m_FileHandle = file;
+    m_MappingHandle = mapping;
+    m_Size = static_cast<std::size_t>(fileSize.QuadPart);
+    m_Data = static_cast<const unsigned char*>(view);
+#else
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        std::cout << "Couldn't open " << path << std::endl;
+        return false;
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+    {
+        close(fd);
+        std::cout << "Couldn't map empty file " << path << std::endl;
+        return false;
+    }
+
+    void* view = mmap(nullptr, static_cast<std::size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (view == MAP_FAILED)
+    {
+        close(fd);
+        std::cout << "Couldn't map " << path << std::endl;
+        return false;
+    }
+
+    m_FileDescriptor = fd;
+    m_Size = static_cast<std::size_t>(fileStat.st_size);
+    m_Data = static_cast<const unsigned char*>(view);
+#endif
+
+    return true;
+    
+} // Open
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void MappedFile::Close()
+{
+    if (m_Data == nullptr)
+    {
+        return;
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile(m_Data);
+    CloseHandle(static_cast<HANDLE>(m_MappingHandle));
+    CloseHandle(static_cast<HANDLE>(m_FileHandle));
+#else
+    munmap(const_cast<unsigned char*>(m_Data), m_Size);
+    close(m_FileDescriptor);
+#endif
+
+    m_Data = nullptr;
+    m_Size = 0;
+    m_FileHandle = nullptr;
+    m_MappingHandle = nullptr;
+    m_FileDescriptor = -1;
+    
+} // Close
+
+// ---------------------------------------------------------------------------------------------------------------------
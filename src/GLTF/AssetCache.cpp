@@ -0,0 +1,512 @@
+﻿#include "GLTF/AssetCache.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+
+#include "Animation/AnimationUtilities.h"
+#include "Animation/Clip.h"
+#include "Animation/FastTrack.h"
+#include "Animation/Frame.h"
+#include "Animation/Interpolation.h"
+#include "Animation/TransformTrack.h"
+#include "Core/MappedFile.h"
+#include "Core/Mat4.h"
+#include "Core/Transform.h"
+#include "Core/TVec2.h"
+#include "Core/TVec4.h"
+#include "GLTF/cgltf.h"
+#include "GLTF/GLTFLoader.h"
+#include "SkeletalMesh/MorphTarget.h"
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+namespace AssetCacheHelpers
+{
+    // FNV-1a 64
+    static constexpr uint64_t FNV_OFFSET = 14695981039346656037ull;
+    static constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+    inline uint64_t HashBytes(const unsigned char* data, std::size_t size, uint64_t hash)
+    {
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            hash = (hash ^ data[i]) * FNV_PRIME;
+        }
+
+        return hash;
+    }
+
+    struct Writer
+    {
+        std::vector<unsigned char> bytes;
+
+        void WriteBytes(const void* data, std::size_t numBytes)
+        {
+            const auto* first = static_cast<const unsigned char*>(data);
+            bytes.insert(bytes.end(), first, first + numBytes);
+        }
+
+        template <typename T>
+        void Write(const T& value)
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "Only raw data can be cooked");
+            WriteBytes(&value, sizeof(T));
+        }
+
+        template <typename T>
+        void WriteArray(const std::vector<T>& values)
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "Only raw data can be cooked");
+            Write(static_cast<uint32_t>(values.size()));
+            WriteBytes(values.data(), values.size() * sizeof(T));
+        }
+
+        void WriteString(const std::string& value)
+        {
+            Write(static_cast<uint32_t>(value.size()));
+            WriteBytes(value.data(), value.size());
+        }
+    };
+
+    // Reads from the mapped cache, every read is bounds checked so truncated files fail instead of crashing
+    struct Reader
+    {
+        const unsigned char* data;
+        std::size_t size;
+        std::size_t offset;
+
+        bool ReadBytes(void* out, std::size_t numBytes)
+        {
+            if (numBytes > size - offset)
+            {
+                return false;
+            }
+
+            memcpy(out, data + offset, numBytes);
+            offset += numBytes;
+            return true;
+        }
+
+        template <typename T>
+        bool Read(T& value)
+        {
+            return ReadBytes(&value, sizeof(T));
+        }
+
+        template <typename T>
+        bool ReadArray(std::vector<T>& values)
+        {
+            uint32_t count;
+            if (!Read(count) || static_cast<uint64_t>(count) * sizeof(T) > size - offset)
+            {
+                return false;
+            }
+
+            values.resize(count);
+            return ReadBytes(values.data(), count * sizeof(T));
+        }
+
+        bool ReadString(std::string& value)
+        {
+            uint32_t length;
+            if (!Read(length) || length > size - offset)
+            {
+                return false;
+            }
+
+            value.assign(reinterpret_cast<const char*>(data + offset), length);
+            offset += length;
+            return true;
+        }
+    };
+
+    inline void WritePose(Writer& writer, const Pose& pose)
+    {
+        const unsigned int numJoints = pose.GetSize();
+        std::vector<Transform> joints(numJoints);
+        std::vector<int> parents(numJoints);
+        
+        for (unsigned int i = 0; i < numJoints; ++i)
+        {
+            joints[i] = pose.GetLocalTransform(i);
+            parents[i] = pose.GetParent(i);
+        }
+
+        writer.WriteArray(joints);
+        writer.WriteArray(parents);
+    }
+
+    inline bool ReadPose(Reader& reader, Pose& outPose)
+    {
+        std::vector<Transform> joints;
+        std::vector<int> parents;
+        if (!reader.ReadArray(joints) || !reader.ReadArray(parents) || joints.size() != parents.size())
+        {
+            return false;
+        }
+
+        const unsigned int numJoints = joints.size();
+        outPose.Resize(numJoints);
+        for (unsigned int i = 0; i < numJoints; ++i)
+        {
+            outPose.SetLocalTransform(i, joints[i]);
+            outPose.SetParent(i, parents[i]);
+        }
+
+        return true;
+    }
+
+    template <typename T, unsigned int N>
+    void WriteTrack(Writer& writer, const FastTrack<T, N>& track)
+    {
+        writer.Write(static_cast<uint32_t>(track.GetInterpolation()));
+        writer.WriteArray(track.GetFrames());
+        writer.WriteArray(track.GetIndexLookupTable());
+    }
+
+    template <typename T, unsigned int N>
+    bool ReadTrack(Reader& reader, FastTrack<T, N>& outTrack)
+    {
+        uint32_t interpolation;
+        if (!reader.Read(interpolation) || interpolation > static_cast<uint32_t>(Interpolation::Cubic))
+        {
+            return false;
+        }
+
+        outTrack.SetInterpolation(static_cast<Interpolation>(interpolation));
+        return reader.ReadArray(outTrack.GetFrames()) && reader.ReadArray(outTrack.GetIndexLookupTable());
+    }
+    
+} // AssetCacheHelpers
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+bool AssetCache::LoadOrCook(const char* gltfPath, CookedAsset& outAsset)
+{
+    const uint64_t sourceHash = HashSource(gltfPath);
+    if (sourceHash == 0)
+    {
+        return false;
+    }
+
+    const std::string cachePath = GetCachePath(gltfPath);
+    if (Load(cachePath.c_str(), sourceHash, outAsset))
+    {
+        return true;
+    }
+
+    if (!Cook(gltfPath, outAsset))
+    {
+        return false;
+    }
+
+    Save(cachePath.c_str(), sourceHash, outAsset);
+    return true;
+    
+} // LoadOrCook
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+bool AssetCache::Cook(const char* gltfPath, CookedAsset& outAsset)
+{
+    GLTFLoadStats loadStats;
+    cgltf_data* gltf = GLTFLoader::LoadGLTFFile(gltfPath, true, &loadStats);
+    if (gltf == nullptr)
+    {
+        return false;
+    }
+
+    std::cout << "Cooking " << gltfPath << ": parse " << loadStats.parseMs << " ms, buffers "
+        << loadStats.loadBuffersMs << " ms (" << loadStats.bufferBytes << " bytes"
+        << (loadStats.bMemoryMapped ? ", mapped" : "") << "), validate " << loadStats.validateMs << " ms"
+        << std::endl;
+    
+    outAsset.meshes = GLTFLoader::LoadSkeletalMeshes(gltf);
+    outAsset.skeleton = GLTFLoader::LoadSkeleton(gltf);
+    const std::vector<Clip> clips = GLTFLoader::LoadAnimationClips(gltf);
+    GLTFLoader::FreeGLTFFile(gltf);
+
+    const BoneMap boneMap = outAsset.skeleton.RearrangeSkeleton();
+    for (SkeletalMesh& mesh : outAsset.meshes)
+    {
+        mesh.RearrangeMesh(boneMap);
+    }
+
+    outAsset.clips.clear();
+    outAsset.clips.reserve(clips.size());
+    for (const Clip& clip : clips)
+    {
+        outAsset.clips.emplace_back(AnimationUtilities::OptimizeClip(clip));
+        outAsset.clips.back().RearrangeClip(boneMap);
+    }
+
+    return true;
+    
+} // Cook
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+bool AssetCache::Load(const char* cachePath, uint64_t sourceHash, CookedAsset& outAsset)
+{
+    using namespace AssetCacheHelpers;
+    
+    const MappedFile file(cachePath);
+    if (!file.IsOpen())
+    {
+        return false;
+    }
+
+    Reader reader = {file.GetData(), file.GetSize(), 0};
+    CookedAssetHeader header;
+    if (!reader.Read(header) || header.magic != COOKED_ASSET_MAGIC || header.version != COOKED_ASSET_VERSION)
+    {
+        std::cout << "Unsupported cooked asset: " << cachePath << std::endl;
+        return false;
+    }
+    if (header.sourceHash != sourceHash)
+    {
+        std::cout << "Outdated cooked asset: " << cachePath << std::endl;
+        return false;
+    }
+
+    // Skeleton
+    Pose restPose;
+    Pose bindPose;
+    std::vector<std::string> jointNames;
+    uint32_t numNames = 0;
+    bool bValid = ReadPose(reader, restPose) && ReadPose(reader, bindPose) && reader.Read(numNames) &&
+        numNames == restPose.GetSize();
+    
+    jointNames.resize(bValid ? numNames : 0);
+    for (std::string& name : jointNames)
+    {
+        bValid = bValid && reader.ReadString(name);
+    }
+
+    // Meshes, GL buffers are created here so this must run on the GL thread
+    std::vector<SkeletalMesh> meshes(bValid ? header.numMeshes : 0);
+    for (SkeletalMesh& mesh : meshes)
+    {
+        bValid = bValid && reader.ReadArray(mesh.GetPosition()) && reader.ReadArray(mesh.GetNormal()) &&
+            reader.ReadArray(mesh.GetTexCoord()) && reader.ReadArray(mesh.GetBonesWeight()) &&
+            reader.ReadArray(mesh.GetBonesID()) && reader.ReadArray(mesh.GetIndices()) &&
+            reader.ReadArray(mesh.GetDefaultMorphWeights());
+
+        std::vector<MorphTarget>& targets = mesh.GetMorphTargets();
+        targets.resize(bValid ? mesh.GetDefaultMorphWeights().size() : 0);
+        for (MorphTarget& target : targets)
+        {
+            bValid = bValid && reader.ReadString(target.name) && reader.ReadArray(target.vertices) &&
+                reader.ReadArray(target.positionDeltas) && reader.ReadArray(target.normalDeltas) &&
+                target.positionDeltas.size() == target.vertices.size() &&
+                (target.normalDeltas.empty() || target.normalDeltas.size() == target.vertices.size());
+        }
+    }
+
+    // Clips
+    std::vector<FastClip> clips(bValid ? header.numClips : 0);
+    for (FastClip& clip : clips)
+    {
+        std::string name;
+        uint32_t bLooping;
+        uint32_t numTracks;
+        bValid = bValid && reader.ReadString(name) && reader.Read(bLooping) && reader.Read(numTracks);
+        
+        for (uint32_t i = 0; bValid && i < numTracks; ++i)
+        {
+            uint32_t id;
+            bValid = reader.Read(id);
+            if (!bValid)
+            {
+                break;
+            }
+
+            FastTransformTrack& track = clip[id];
+            bValid = ReadTrack(reader, track.GetPositionTrack()) && ReadTrack(reader, track.GetRotationTrack()) &&
+                ReadTrack(reader, track.GetScaleTrack());
+        }
+
+        clip.SetName(name);
+        clip.SetLooping(bLooping != 0);
+        clip.RecalculateDuration();
+    }
+
+    if (!bValid)
+    {
+        std::cout << "Corrupted cooked asset: " << cachePath << std::endl;
+        return false;
+    }
+
+    for (const SkeletalMesh& mesh : meshes)
+    {
+        mesh.UpdateOpenGLBuffers();
+    }
+
+    outAsset.skeleton.Set(restPose, bindPose, jointNames);
+    outAsset.meshes = std::move(meshes);
+    outAsset.clips = std::move(clips);
+    return true;
+    
+} // Load
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+bool AssetCache::Save(const char* cachePath, uint64_t sourceHash, const CookedAsset& asset)
+{
+    using namespace AssetCacheHelpers;
+    
+    Writer writer;
+
+    CookedAssetHeader header = {};
+    header.magic = COOKED_ASSET_MAGIC;
+    header.version = COOKED_ASSET_VERSION;
+    header.sourceHash = sourceHash;
+    header.numMeshes = asset.meshes.size();
+    header.numClips = asset.clips.size();
+    writer.Write(header);
+
+    // Skeleton, the inverse bind pose is rebuilt on load
+    const std::vector<std::string>& jointNames = asset.skeleton.GetJointNames();
+    WritePose(writer, asset.skeleton.GetRestPose());
+    WritePose(writer, asset.skeleton.GetBindPose());
+    writer.Write(static_cast<uint32_t>(jointNames.size()));
+    for (const std::string& name : jointNames)
+    {
+        writer.WriteString(name);
+    }
+
+    // Meshes
+    for (const SkeletalMesh& mesh : asset.meshes)
+    {
+        writer.WriteArray(mesh.GetPosition());
+        writer.WriteArray(mesh.GetNormal());
+        writer.WriteArray(mesh.GetTexCoord());
+        writer.WriteArray(mesh.GetBonesWeight());
+        writer.WriteArray(mesh.GetBonesID());
+        writer.WriteArray(mesh.GetIndices());
+        
+        // One default weight per morph target, the count doubles as the number of targets
+        writer.WriteArray(mesh.GetDefaultMorphWeights());
+        for (const MorphTarget& target : mesh.GetMorphTargets())
+        {
+            writer.WriteString(target.name);
+            writer.WriteArray(target.vertices);
+            writer.WriteArray(target.positionDeltas);
+            writer.WriteArray(target.normalDeltas);
+        }
+    }
+
+    // Clips, with the lookup tables of the optimized tracks
+    for (const FastClip& clip : asset.clips)
+    {
+        const unsigned int numTracks = clip.GetSize();
+        writer.WriteString(clip.GetName());
+        writer.Write(static_cast<uint32_t>(clip.IsLooping()));
+        writer.Write(static_cast<uint32_t>(numTracks));
+        
+        for (unsigned int i = 0; i < numTracks; ++i)
+        {
+            const unsigned int id = clip.GetIDAtIndex(i);
+            const FastTransformTrack& track = clip[id];
+            writer.Write(static_cast<uint32_t>(id));
+            WriteTrack(writer, track.GetPositionTrack());
+            WriteTrack(writer, track.GetRotationTrack());
+            WriteTrack(writer, track.GetScaleTrack());
+        }
+    }
+
+    std::ofstream file;
+    file.open(cachePath, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+        std::cout << "Couldn't open " << cachePath << std::endl;
+        return false;
+    }
+
+    file.write(reinterpret_cast<const char*>(writer.bytes.data()), static_cast<std::streamsize>(writer.bytes.size()));
+    const bool bSuccess = file.good();
+    file.close();
+    return bSuccess;
+    
+} // Save
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+std::string AssetCache::GetCachePath(const char* gltfPath)
+{
+    return std::string(gltfPath) + ".cooked";
+    
+} // GetCachePath
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+uint64_t AssetCache::HashSource(const char* gltfPath)
+{
+    using namespace AssetCacheHelpers;
+    
+    uint64_t hash = HashFile(gltfPath);
+    if (hash == 0)
+    {
+        return 0;
+    }
+
+    // Only the JSON is parsed, the buffers are hashed straight from their files
+    cgltf_options options = {};
+    cgltf_data* data = nullptr;
+    if (cgltf_parse_file(&options, gltfPath, &data) != cgltf_result_success)
+    {
+        std::cout << "Could not parse: " << gltfPath << std::endl;
+        return 0;
+    }
+
+    // Buffers embedded in the .glb or as data URIs are already part of the source file. Images aren't cooked
+    const std::string path(gltfPath);
+    const std::size_t slash = path.find_last_of("/\\");
+    const std::string directory = slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+    
+    for (cgltf_size i = 0; i < data->buffers_count; ++i)
+    {
+        const char* uri = data->buffers[i].uri;
+        if (uri == nullptr || strncmp(uri, "data:", 5) == 0)
+        {
+            continue;
+        }
+
+        std::string bufferPath = directory + uri;
+        bufferPath.resize(directory.size() + cgltf_decode_uri(&bufferPath[directory.size()]));
+        
+        const uint64_t bufferHash = HashFile(bufferPath.c_str());
+        if (bufferHash == 0)
+        {
+            std::cout << "Could not read buffer: " << bufferPath << std::endl;
+            hash = 0;
+            break;
+        }
+        
+        hash = HashBytes(reinterpret_cast<const unsigned char*>(&bufferHash), sizeof(bufferHash), hash);
+    }
+
+    cgltf_free(data);
+    return hash;
+    
+} // HashSource
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+uint64_t AssetCache::HashFile(const char* path)
+{
+    using namespace AssetCacheHelpers;
+    
+    const MappedFile file(path);
+    if (!file.IsOpen())
+    {
+        return 0;
+    }
+
+    return HashBytes(file.GetData(), file.GetSize(), FNV_OFFSET);
+    
+} // HashFile
+
+// ---------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,258 @@
+﻿#include "GLTF/ClipCatalog.h"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <mutex>
+
+#include "Animation/Clip.h"
+#include "Animation/Track.h"
+#include "Animation/TransformTrack.h"
+#include "Core/Transform.h"
+#include "GLTF/cgltf.h"
+#include "GLTF/GLTFLoader.h"
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+struct ClipCatalogEntry
+{
+    const cgltf_animation* animation = nullptr;
+    std::string name;
+    float startTime = 0.f;
+    float endTime = 0.f;
+
+    std::once_flag decodeFlag;
+    std::atomic<bool> bDecoded{false};
+    Clip clip;
+    
+}; // ClipCatalogEntry
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+namespace ClipCatalogHelpers
+{
+    // glTF requires min/max on animation inputs, the first and last keys are read when an exporter skips them
+    inline void GetInputRange(const cgltf_accessor& input, float& outStart, float& outEnd)
+    {
+        if (input.has_min && input.has_max)
+        {
+            outStart = input.min[0];
+            outEnd = input.max[0];
+            return;
+        }
+
+        outStart = 0.f;
+        outEnd = 0.f;
+        if (input.count > 0)
+        {
+            cgltf_accessor_read_float(&input, 0, &outStart, 1);
+            cgltf_accessor_read_float(&input, input.count - 1, &outEnd, 1);
+        }
+    }
+    
+} // ClipCatalogHelpers
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+ClipCatalog::ClipCatalog()
+{
+    
+} // ClipCatalog
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+ClipCatalog::ClipCatalog(cgltf_data* data)
+{
+    Open(data);
+    
+} // ClipCatalog
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+ClipCatalog::~ClipCatalog()
+{
+    Close();
+    
+} // ~ClipCatalog
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+bool ClipCatalog::Open(const char* path)
+{
+    cgltf_data* data = GLTFLoader::LoadGLTFFile(path);
+    if (data == nullptr)
+    {
+        return false;
+    }
+
+    Open(data);
+    return true;
+    
+} // Open
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void ClipCatalog::Open(cgltf_data* data)
+{
+    Close();
+    m_Data = data;
+    if (m_Data == nullptr)
+    {
+        return;
+    }
+
+    // Only the time ranges are read, the keyframes stay in the file until a clip is decoded
+    const unsigned int numClips = m_Data->animations_count;
+    m_Entries.reserve(numClips);
+    
+    for (unsigned int i = 0; i < numClips; ++i)
+    {
+        const cgltf_animation& animation = m_Data->animations[i];
+        std::unique_ptr<ClipCatalogEntry> entry(new ClipCatalogEntry());
+        entry->animation = &animation;
+        entry->name = animation.name == nullptr ? "" : animation.name;
+
+        float startTime = std::numeric_limits<float>::max();
+        float endTime = std::numeric_limits<float>::lowest();
+        
+        for (unsigned int j = 0; j < animation.channels_count; ++j)
+        {
+            const cgltf_animation_channel& channel = animation.channels[j];
+            if (channel.target_path != cgltf_animation_path_type_translation &&
+                channel.target_path != cgltf_animation_path_type_rotation &&
+                channel.target_path != cgltf_animation_path_type_scale)
+            {
+                continue;
+            }
+
+            float channelStart;
+            float channelEnd;
+            ClipCatalogHelpers::GetInputRange(*channel.sampler->input, channelStart, channelEnd);
+            startTime = std::min(startTime, channelStart);
+            endTime = std::max(endTime, channelEnd);
+        }
+
+        const bool bHasChannels = startTime <= endTime;
+        entry->startTime = bHasChannels ? startTime : 0.f;
+        entry->endTime = bHasChannels ? endTime : 0.f;
+        m_Entries.emplace_back(std::move(entry));
+    }
+    
+} // Open
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void ClipCatalog::Close()
+{
+    for (std::thread& worker : m_Workers)
+    {
+        worker.join();
+    }
+    m_Workers.clear();
+    m_Entries.clear();
+
+    if (m_Data != nullptr)
+    {
+        GLTFLoader::FreeGLTFFile(m_Data);
+        m_Data = nullptr;
+    }
+    
+} // Close
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+unsigned ClipCatalog::GetNumClips() const
+{
+    return m_Entries.size();
+    
+} // GetNumClips
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+const std::string& ClipCatalog::GetName(unsigned idx) const
+{
+    return m_Entries[idx]->name;
+    
+} // GetName
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+float ClipCatalog::GetStartTime(unsigned idx) const
+{
+    return m_Entries[idx]->startTime;
+    
+} // GetStartTime
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+float ClipCatalog::GetEndTime(unsigned idx) const
+{
+    return m_Entries[idx]->endTime;
+    
+} // GetEndTime
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+float ClipCatalog::GetDuration(unsigned idx) const
+{
+    return m_Entries[idx]->endTime - m_Entries[idx]->startTime;
+    
+} // GetDuration
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+int ClipCatalog::FindClip(const std::string& name) const
+{
+    const unsigned int numClips = m_Entries.size();
+    for (unsigned int i = 0; i < numClips; ++i)
+    {
+        if (m_Entries[i]->name == name)
+        {
+            return static_cast<int>(i);
+        }
+    }
+
+    return -1;
+    
+} // FindClip
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+bool ClipCatalog::IsDecoded(unsigned idx) const
+{
+    return m_Entries[idx]->bDecoded;
+    
+} // IsDecoded
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+const Clip& ClipCatalog::GetClip(unsigned idx)
+{
+    ClipCatalogEntry& entry = *m_Entries[idx];
+    
+    // call_once blocks other callers until the decoding thread is done
+    std::call_once(entry.decodeFlag, [this, &entry]()
+    {
+        GLTFLoader::LoadAnimationClip(entry.clip, *entry.animation, m_Data);
+        entry.bDecoded = true;
+    });
+
+    return entry.clip;
+    
+} // GetClip
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void ClipCatalog::PrefetchAsync(const std::vector<unsigned>& clips)
+{
+    m_Workers.emplace_back([this, clips]()
+    {
+        for (const unsigned int idx : clips)
+        {
+            GetClip(idx);
+        }
+    });
+    
+} // PrefetchAsync
+
+// ---------------------------------------------------------------------------------------------------------------------
@@ -1,6 +1,15 @@
 ﻿#include "GLTF/GLTFLoader.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 #include <ostream>
 
 #include "Animation/Clip.h"
@@ -9,21 +18,175 @@
 #include "Animation/Track.h"
 #include "Animation/TransformTrack.h"
 #include "Core/BasicUtils.h"
+#include "Core/MappedFile.h"
 #include "Core/Mat4.h"
 #include "Core/Transform.h"
 #include "Core/TVec2.h"
 #include "GLTF/cgltf.h"
+#include "SkeletalMesh/MeshOptimizer.h"
+#include "SkeletalMesh/MorphTarget.h"
 #include "SkeletalMesh/Pose.h"
 #include "SkeletalMesh/SkeletalMesh.h"
 #include "SkeletalMesh/Skeleton.h"
 
 // ---------------------------------------------------------------------------------------------------------------------
 
-cgltf_data* GLTFLoader::LoadGLTFFile(const char* path)
+namespace GLTFHelpers
 {
-    constexpr cgltf_options options = {};
+    // Files mapped for cgltf, keyed by their data so they can be unmapped when cgltf releases it
+    struct MappedFileRegistry
+    {
+        std::mutex mutex;
+        std::unordered_map<const void*, std::unique_ptr<MappedFile>> files;
+    };
+
+    inline MappedFileRegistry& GetMappedFiles()
+    {
+        static MappedFileRegistry registry;
+        return registry;
+    }
+
+    inline cgltf_result MapFile(const cgltf_memory_options*, const cgltf_file_options*, const char* path,
+        cgltf_size* size, void** data)
+    {
+        std::unique_ptr<MappedFile> file(new MappedFile());
+        if (!file->Open(path))
+        {
+            return cgltf_result_file_not_found;
+        }
+
+        // cgltf only reads file data, the mapping itself is read only
+        *size = file->GetSize();
+        *data = const_cast<unsigned char*>(file->GetData());
+
+        MappedFileRegistry& registry = GetMappedFiles();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.files.emplace(*data, std::move(file));
+        return cgltf_result_success;
+    }
+
+    inline void UnmapFile(const cgltf_memory_options*, const cgltf_file_options*, void* data)
+    {
+        MappedFileRegistry& registry = GetMappedFiles();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.files.erase(data);
+    }
+
+    inline float GetElapsedMs(const std::chrono::steady_clock::time_point& start)
+    {
+        const std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count();
+    }
+    
+    inline cgltf_size GetComponentSize(cgltf_component_type type)
+    {
+        switch (type)
+        {
+            case cgltf_component_type_r_8:
+            case cgltf_component_type_r_8u:
+                return 1;
+            case cgltf_component_type_r_16:
+            case cgltf_component_type_r_16u:
+                return 2;
+            case cgltf_component_type_r_32u:
+            case cgltf_component_type_r_32f:
+                return 4;
+            default:
+                return 0;
+        }
+    }
+
+    // First element of an accessor whose elements follow each other with no padding, null for other layouts
+    inline const uint8_t* GetTightlyPackedData(const cgltf_accessor& accessor, unsigned int compCount)
+    {
+        const cgltf_size elementSize = GetComponentSize(accessor.component_type) * compCount;
+        if (accessor.is_sparse || accessor.normalized || accessor.buffer_view == nullptr || elementSize == 0 ||
+            accessor.stride != elementSize || cgltf_num_components(accessor.type) != compCount)
+        {
+            return nullptr;
+        }
+
+        const uint8_t* data = cgltf_buffer_view_data(accessor.buffer_view);
+        return data == nullptr ? nullptr : data + accessor.offset;
+    }
+
+    template <typename SRC, typename DST>
+    inline void ConvertValues(const uint8_t* src, DST* dst, cgltf_size count)
+    {
+        // glTF aligns accessors to their component size
+        const SRC* values = reinterpret_cast<const SRC*>(src);
+        for (cgltf_size i = 0; i < count; ++i)
+        {
+            dst[i] = static_cast<DST>(values[i]);
+        }
+    }
+
+    // Runs task(i) for every i in [0, count) on numThreads threads (0 = hardware concurrency), caller included
+    template <typename TASK>
+    void ParallelFor(unsigned int count, unsigned int numThreads, const TASK& task)
+    {
+        if (numThreads == 0)
+        {
+            numThreads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        numThreads = std::min(numThreads, count);
+
+        if (numThreads <= 1)
+        {
+            for (unsigned int i = 0; i < count; ++i)
+            {
+                task(i);
+            }
+            return;
+        }
+
+        // Items differ a lot in size (a body mesh against a prop), so threads pull the next one when done
+        std::atomic<unsigned int> nextItem{0};
+        auto Worker = [&]()
+        {
+            for (unsigned int i = nextItem++; i < count; i = nextItem++)
+            {
+                task(i);
+            }
+        };
+
+        std::vector<std::thread> workers;
+        workers.reserve(numThreads - 1);
+        for (unsigned int i = 1; i < numThreads; ++i)
+        {
+            workers.emplace_back(Worker);
+        }
+
+        Worker();
+        for (std::thread& worker : workers)
+        {
+            worker.join();
+        }
+    }
+    
+} // GLTFHelpers
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+cgltf_data* GLTFLoader::LoadGLTFFile(const char* path, bool bMemoryMap, GLTFLoadStats* outStats)
+{
+    using namespace GLTFHelpers;
+    
+    // File type is detected from the content, .glb binary chunks are used in place
+    cgltf_options options = {};
+    if (bMemoryMap)
+    {
+        options.file.read = &MapFile;
+        options.file.release = &UnmapFile;
+    }
+
+    GLTFLoadStats stats;
+    stats.bMemoryMapped = bMemoryMap;
+    
+    auto stepStart = std::chrono::steady_clock::now();
     cgltf_data* data = nullptr;
     cgltf_result result = cgltf_parse_file(&options, path, &data);
+    stats.parseMs = GetElapsedMs(stepStart);
 
     if (result != cgltf_result_success)
     {
@@ -31,7 +194,10 @@ cgltf_data* GLTFLoader::LoadGLTFFile(const char* path)
         return nullptr;
     }
 
+    stepStart = std::chrono::steady_clock::now();
     result = cgltf_load_buffers(&options, data, path);
+    stats.loadBuffersMs = GetElapsedMs(stepStart);
+    
     if (result != cgltf_result_success)
     {
         cgltf_free(data);
@@ -39,7 +205,10 @@ cgltf_data* GLTFLoader::LoadGLTFFile(const char* path)
         return nullptr;
     }
 
+    stepStart = std::chrono::steady_clock::now();
     result = cgltf_validate(data);
+    stats.validateMs = GetElapsedMs(stepStart);
+    
     if (result != cgltf_result_success)
     {
         cgltf_free(data);
@@ -47,6 +216,15 @@ cgltf_data* GLTFLoader::LoadGLTFFile(const char* path)
         return nullptr;
     }
 
+    if (outStats != nullptr)
+    {
+        for (cgltf_size i = 0; i < data->buffers_count; ++i)
+        {
+            stats.bufferBytes += data->buffers[i].size;
+        }
+        *outStats = stats;
+    }
+
     return data;
     
 } // LoadGLTFFile
@@ -85,9 +263,16 @@ Pose GLTFLoader::LoadRestPose(const cgltf_data* data)
 
 // ---------------------------------------------------------------------------------------------------------------------
 
-Pose GLTFLoader::LoadBindPose(const cgltf_data* data)
+Pose GLTFLoader::LoadBindPose(const cgltf_data* data, int skinIdx)
+{
+    return BindPoseFromRestPose(data, LoadRestPose(data), skinIdx);
+    
+} // LoadBindPose
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+Pose GLTFLoader::BindPoseFromRestPose(const cgltf_data* data, const Pose& restPose, int skinIdx)
 {
-    const Pose restPose = LoadRestPose(data);
     const unsigned int numBones = restPose.GetSize();
 
     // Use rest pose as default value if inverse bind pose is not available
@@ -99,9 +284,16 @@ Pose GLTFLoader::LoadBindPose(const cgltf_data* data)
 
     // Load and use inverse bind pose to obtain the bind transform
     const unsigned int numSkins = data->skins_count;
-    for (unsigned int i = 0; i < numSkins; ++i)
+    const unsigned int firstSkin = skinIdx < 0 ? 0 : skinIdx;
+    const unsigned int lastSkin = skinIdx < 0 ? numSkins : std::min<unsigned int>(skinIdx + 1, numSkins);
+    for (unsigned int i = firstSkin; i < lastSkin; ++i)
     {
         const cgltf_skin& skin = data->skins[i];
+        if (skin.inverse_bind_matrices == nullptr)
+        {
+            continue;
+        }
+        
         std::vector<float> invBindAccessor;
         GetScalarValues(invBindAccessor, 16, *skin.inverse_bind_matrices);
 
@@ -132,7 +324,7 @@ Pose GLTFLoader::LoadBindPose(const cgltf_data* data)
 
     return bindPose;
     
-} // LoadBindPose
+} // BindPoseFromRestPose
 
 // ---------------------------------------------------------------------------------------------------------------------
 
@@ -153,74 +345,110 @@ std::vector<std::string> GLTFLoader::LoadJointNames(const cgltf_data* data)
 
 // ---------------------------------------------------------------------------------------------------------------------
 
-Skeleton GLTFLoader::LoadSkeleton(const cgltf_data* data)
+Skeleton GLTFLoader::LoadSkeleton(const cgltf_data* data, int skinIdx)
 {
-    return {LoadRestPose(data), LoadBindPose(data), LoadJointNames(data)};
+    return {LoadRestPose(data), LoadBindPose(data, skinIdx), LoadJointNames(data)};
     
 } // LoadSkeleton
 
 // ---------------------------------------------------------------------------------------------------------------------
 
-std::vector<SkeletalMesh> GLTFLoader::LoadSkeletalMeshes(const cgltf_data* data)
+std::vector<Skeleton> GLTFLoader::LoadSkinSkeletons(const cgltf_data* data)
+{
+    const Pose restPose = LoadRestPose(data);
+    const std::vector<std::string> jointNames = LoadJointNames(data);
+
+    const unsigned int numSkins = data->skins_count;
+    std::vector<Skeleton> result;
+    result.reserve(numSkins);
+    for (unsigned int i = 0; i < numSkins; ++i)
+    {
+        result.emplace_back(restPose, BindPoseFromRestPose(data, restPose, i), jointNames);
+    }
+
+    return result;
+    
+} // LoadSkinSkeletons
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+std::vector<SkeletalMesh> GLTFLoader::LoadSkeletalMeshes(const cgltf_data* data, unsigned numThreads)
 {
-    return LoadMeshes(data, true);
+    return LoadMeshes(data, true, numThreads, nullptr);
     
 } // LoadSkeletalMeshes
 
 // ---------------------------------------------------------------------------------------------------------------------
 
-std::vector<SkeletalMesh> GLTFLoader::LoadStaticMeshes(const cgltf_data* data)
+std::vector<SkeletalMesh> GLTFLoader::LoadSkeletalMeshes(const cgltf_data* data, std::vector<int>& outSkinIndices,
+    unsigned numThreads)
 {
-    return LoadMeshes(data, false);
+    return LoadMeshes(data, true, numThreads, &outSkinIndices);
+    
+} // LoadSkeletalMeshes
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+std::vector<SkeletalMesh> GLTFLoader::LoadStaticMeshes(const cgltf_data* data, unsigned numThreads)
+{
+    return LoadMeshes(data, false, numThreads, nullptr);
     
 } // LoadStaticMeshes
 
 // ---------------------------------------------------------------------------------------------------------------------
 
-std::vector<Clip> GLTFLoader::LoadAnimationClips(const cgltf_data* data)
+std::vector<Clip> GLTFLoader::LoadAnimationClips(const cgltf_data* data, unsigned numThreads)
 {
     const unsigned int numClips = data->animations_count;
-    const unsigned int numNodes = data->nodes_count;
 
     std::vector<Clip> result;
     result.resize(numClips);
 
-    for (unsigned int i = 0; i < numClips; ++i)
+    // Clips only read the parsed file and write their own tracks
+    GLTFHelpers::ParallelFor(numClips, numThreads, [&](unsigned int i)
     {
-        const cgltf_animation& animation = data->animations[i];
-        result[i].SetName(animation.name);
+        LoadAnimationClip(result[i], data->animations[i], data);
+    });
 
-        const unsigned int numChannels = animation.channels_count;
-        for (unsigned int j = 0; j < numChannels; ++j)
-        {
-            const cgltf_animation_channel& channel = animation.channels[j];
-            const cgltf_node* target = channel.target_node;
-            const int nodeID = GetNodeIndex(target, data->nodes, numNodes);
+    return result;
+    
+} // LoadAnimationClips
 
-            TransformTrack& transformTrack = result[i][nodeID];
-            if (channel.target_path == cgltf_animation_path_type_translation)
-            {
-                VectorTrack& track = transformTrack.GetPositionTrack();
-                TrackFromChannel(track, channel);
-            }
-            else if (channel.target_path == cgltf_animation_path_type_scale)
-            {
-                VectorTrack& track = transformTrack.GetScaleTrack();
-                TrackFromChannel(track, channel);
-            }
-            else if (channel.target_path == cgltf_animation_path_type_rotation)
-            {
-                QuaternionTrack& track = transformTrack.GetRotationTrack();
-                TrackFromChannel(track, channel);
-            }
-        }
+// ---------------------------------------------------------------------------------------------------------------------
+
+void GLTFLoader::LoadAnimationClip(Clip& outClip, const cgltf_animation& animation, const cgltf_data* data)
+{
+    const unsigned int numNodes = data->nodes_count;
+    outClip.SetName(animation.name);
+
+    const unsigned int numChannels = animation.channels_count;
+    for (unsigned int j = 0; j < numChannels; ++j)
+    {
+        const cgltf_animation_channel& channel = animation.channels[j];
+        const cgltf_node* target = channel.target_node;
+        const int nodeID = GetNodeIndex(target, data->nodes, numNodes);
 
-        result[i].RecalculateDuration();
+        TransformTrack& transformTrack = outClip[nodeID];
+        if (channel.target_path == cgltf_animation_path_type_translation)
+        {
+            VectorTrack& track = transformTrack.GetPositionTrack();
+            TrackFromChannel(track, channel);
+        }
+        else if (channel.target_path == cgltf_animation_path_type_scale)
+        {
+            VectorTrack& track = transformTrack.GetScaleTrack();
+            TrackFromChannel(track, channel);
+        }
+        else if (channel.target_path == cgltf_animation_path_type_rotation)
+        {
+            QuaternionTrack& track = transformTrack.GetRotationTrack();
+            TrackFromChannel(track, channel);
+        }
     }
 
-    return result;
+    outClip.RecalculateDuration();
     
-} // LoadAnimationClips
+} // LoadAnimationClip
 
 // ---------------------------------------------------------------------------------------------------------------------
 
@@ -253,28 +481,79 @@ Transform GLTFLoader::GetLocalTransforms(const cgltf_node& n)
 
 int GLTFLoader::GetNodeIndex(const cgltf_node* target, const cgltf_node* allNodes, unsigned int numNodes)
 {
-    if (target == nullptr)
+    // std::less gives a total order even for pointers outside the node array
+    const std::less<const cgltf_node*> less;
+    if (target == nullptr || less(target, allNodes) || !less(target, allNodes + numNodes))
     {
         return -1;
     }
 
-    for (unsigned int i = 0; i < numNodes; ++i)
+    return static_cast<int>(target - allNodes);
+    
+} // GetNodeIndex
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+std::vector<int> GLTFLoader::GetSkinJointNodes(const cgltf_skin* skin, const cgltf_node* nodes, unsigned numNodes)
+{
+    if (skin == nullptr)
     {
-        if (target == &allNodes[i])
-        {
-            return static_cast<int>(i);
-        }
+        return {};
     }
+
+    const unsigned int numJoints = skin->joints_count;
+    std::vector<int> result(numJoints);
+    for (unsigned int i = 0; i < numJoints; ++i)
+    {
+        result[i] = GetNodeIndex(skin->joints[i], nodes, numNodes);
+    }
+
+    return result;
     
-    return -1;
-    
-} // GetNodeIndex
+} // GetSkinJointNodes
 
 // ---------------------------------------------------------------------------------------------------------------------
 
 void GLTFLoader::GetScalarValues(std::vector<float>& out, unsigned int compCount, const cgltf_accessor& accessor)
 {
-    out.resize(accessor.count * compCount);
+    using namespace GLTFHelpers;
+    
+    const cgltf_size numValues = accessor.count * compCount;
+    out.resize(numValues);
+    if (numValues == 0)
+    {
+        return;
+    }
+
+    const uint8_t* packedData = GetTightlyPackedData(accessor, compCount);
+    if (packedData != nullptr)
+    {
+        switch (accessor.component_type)
+        {
+            case cgltf_component_type_r_32f:
+                memcpy(out.data(), packedData, numValues * sizeof(float));
+                return;
+            case cgltf_component_type_r_8u:
+                ConvertValues<uint8_t>(packedData, out.data(), numValues);
+                return;
+            case cgltf_component_type_r_16u:
+                ConvertValues<uint16_t>(packedData, out.data(), numValues);
+                return;
+            case cgltf_component_type_r_32u:
+                ConvertValues<uint32_t>(packedData, out.data(), numValues);
+                return;
+            default:
+                break;
+        }
+    }
+
+    // Sparse accessors need the base values patched, cgltf_accessor_read_float rejects them
+    if (accessor.is_sparse && cgltf_num_components(accessor.type) == compCount)
+    {
+        cgltf_accessor_unpack_floats(&accessor, out.data(), numValues);
+        return;
+    }
+    
     for (cgltf_size i = 0; i < accessor.count; ++i)
     {
         cgltf_accessor_read_float(&accessor, i, &out[i * compCount], compCount);
@@ -284,8 +563,47 @@ void GLTFLoader::GetScalarValues(std::vector<float>& out, unsigned int compCount
 
 // ---------------------------------------------------------------------------------------------------------------------
 
-void GLTFLoader::MeshFromAttribute(SkeletalMesh& outMesh, const cgltf_attribute& attribute, const cgltf_skin* skin,
-    const cgltf_node* nodes, unsigned nodeCount)
+void GLTFLoader::GetIndexValues(std::vector<unsigned>& out, const cgltf_accessor& accessor)
+{
+    using namespace GLTFHelpers;
+    
+    const cgltf_size numIndices = accessor.count;
+    out.resize(numIndices);
+    if (numIndices == 0)
+    {
+        return;
+    }
+
+    const uint8_t* packedData = GetTightlyPackedData(accessor, 1);
+    if (packedData != nullptr)
+    {
+        switch (accessor.component_type)
+        {
+            case cgltf_component_type_r_32u:
+                memcpy(out.data(), packedData, numIndices * sizeof(unsigned int));
+                return;
+            case cgltf_component_type_r_16u:
+                ConvertValues<uint16_t>(packedData, out.data(), numIndices);
+                return;
+            case cgltf_component_type_r_8u:
+                ConvertValues<uint8_t>(packedData, out.data(), numIndices);
+                return;
+            default:
+                break;
+        }
+    }
+
+    for (cgltf_size i = 0; i < numIndices; ++i)
+    {
+        out[i] = cgltf_accessor_read_index(&accessor, i);
+    }
+    
+} // GetIndexValues
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void GLTFLoader::MeshFromAttribute(SkeletalMesh& outMesh, const cgltf_attribute& attribute,
+    const std::vector<int>& skinJointNodes)
 {
     const cgltf_accessor& accessor = *attribute.data;
 
@@ -310,56 +628,167 @@ void GLTFLoader::MeshFromAttribute(SkeletalMesh& outMesh, const cgltf_attribute&
     std::vector<float> values;
     GetScalarValues(values, componentCount, accessor);
 
-    // Fill appropriate data with the attribute data
+    // Fill appropriate data with the attribute data, the switch is hoisted so each loop only converts values
     const unsigned int accessorCount = accessor.count;
-    for (unsigned int i = 0; i < accessorCount; ++i)
+    switch (attribute.type)
     {
-        const float* attributeValue = &values[i * componentCount];
-        switch (attribute.type)
+        case cgltf_attribute_type_position:
         {
-            case cgltf_attribute_type_position:
-                outMesh.GetPosition().emplace_back(Vec3{attributeValue});
-                break;
-            case cgltf_attribute_type_texcoord:
-                outMesh.GetTexCoord().emplace_back(Vec2{attributeValue});
-                break;
-            case cgltf_attribute_type_weights:
-                outMesh.GetBonesWeight().emplace_back(Vec4{attributeValue});
-                break;
-            case cgltf_attribute_type_normal:
+            std::vector<Vec3>& positions = outMesh.GetPosition();
+            positions.reserve(positions.size() + accessorCount);
+            for (unsigned int i = 0; i < accessorCount; ++i)
+            {
+                positions.emplace_back(&values[i * componentCount]);
+            }
+            break;
+        }
+        case cgltf_attribute_type_texcoord:
+        {
+            std::vector<Vec2>& texCoords = outMesh.GetTexCoord();
+            texCoords.reserve(texCoords.size() + accessorCount);
+            for (unsigned int i = 0; i < accessorCount; ++i)
             {
-                const Vec3 normal = Vec3{attributeValue}.Normalized();
-                outMesh.GetNormal().emplace_back(normal.IsZeroVec() ? Vec3{0.f, 1.f, 0.f} : normal);
-                break;  
+                texCoords.emplace_back(&values[i * componentCount]);
             }
-            case cgltf_attribute_type_joints:
+            break;
+        }
+        case cgltf_attribute_type_weights:
+        {
+            std::vector<Vec4>& weights = outMesh.GetBonesWeight();
+            weights.reserve(weights.size() + accessorCount);
+            for (unsigned int i = 0; i < accessorCount; ++i)
             {
+                weights.emplace_back(&values[i * componentCount]);
+            }
+            break;
+        }
+        case cgltf_attribute_type_normal:
+        {
+            std::vector<Vec3>& normals = outMesh.GetNormal();
+            normals.reserve(normals.size() + accessorCount);
+            for (unsigned int i = 0; i < accessorCount; ++i)
+            {
+                const Vec3 normal = Vec3{&values[i * componentCount]}.Normalized();
+                normals.emplace_back(normal.IsZeroVec() ? Vec3{0.f, 1.f, 0.f} : normal);
+            }
+            break;  
+        }
+        case cgltf_attribute_type_joints:
+        {
+            std::vector<IVec4>& bonesIDs = outMesh.GetBonesID();
+            bonesIDs.reserve(bonesIDs.size() + accessorCount);
+            
+            // Replace skin joint ID to skeleton hierarchy boneID
+            const int numSkinJoints = static_cast<int>(skinJointNodes.size());
+            for (unsigned int i = 0; i < accessorCount; ++i)
+            {
+                const float* attributeValue = &values[i * componentCount];
                 IVec4 bonesID;
-                // Replace node ID to skeleton hierarchy boneID
                 for (unsigned int j = 0; j < 4; ++j)
                 {
-                    const int nodeID = BasicUtils::FloatToInt(*(attributeValue + j));
-                    const int boneID = GetNodeIndex(skin->joints[nodeID], nodes, nodeCount);
+                    const int jointID = BasicUtils::FloatToInt(attributeValue[j]);
+                    const int boneID = jointID >= 0 && jointID < numSkinJoints ? skinJointNodes[jointID] : -1;
                     bonesID[j] = std::max(0, boneID);
                 }
-                outMesh.GetBonesID().emplace_back(bonesID);
-                break;
+                bonesIDs.emplace_back(bonesID);
             }
-            default:
-                break;
+            break;
         }
+        default:
+            break;
     }
     
 } // MeshFromAttribute
 
 // ---------------------------------------------------------------------------------------------------------------------
 
-std::vector<SkeletalMesh> GLTFLoader::LoadMeshes(const cgltf_data* data, bool bMustHaveSkin)
+void GLTFLoader::MorphTargetsFromPrimitive(SkeletalMesh& outMesh, const cgltf_primitive& primitive,
+    const cgltf_mesh& mesh)
 {
-    std::vector<SkeletalMesh> result;
+    const unsigned int numTargets = primitive.targets_count;
+    const unsigned int numVertices = outMesh.GetPosition().size();
+    if (numTargets == 0 || numVertices == 0)
+    {
+        return;
+    }
+
+    std::vector<MorphTarget>& targets = outMesh.GetMorphTargets();
+    targets.resize(numTargets);
+
+    std::vector<float> positionDeltas;
+    std::vector<float> normalDeltas;
+    for (unsigned int t = 0; t < numTargets; ++t)
+    {
+        const cgltf_morph_target& gltfTarget = primitive.targets[t];
+        MorphTarget& target = targets[t];
+        target.name = t < mesh.target_names_count && mesh.target_names[t] != nullptr ? mesh.target_names[t] : "";
+
+        positionDeltas.clear();
+        normalDeltas.clear();
+        for (unsigned int k = 0; k < gltfTarget.attributes_count; ++k)
+        {
+            const cgltf_attribute& attribute = gltfTarget.attributes[k];
+            if (attribute.data->count != numVertices)
+            {
+                continue;
+            }
+            
+            if (attribute.type == cgltf_attribute_type_position)
+            {
+                GetScalarValues(positionDeltas, 3, *attribute.data);
+            }
+            else if (attribute.type == cgltf_attribute_type_normal)
+            {
+                GetScalarValues(normalDeltas, 3, *attribute.data);
+            }
+        }
+
+        const bool bHasPositions = !positionDeltas.empty();
+        const bool bHasNormals = !normalDeltas.empty();
+        for (unsigned int v = 0; v < numVertices; ++v)
+        {
+            const Vec3 positionDelta = bHasPositions ? Vec3{&positionDeltas[v * 3]} : Vec3{0.f, 0.f, 0.f};
+            const Vec3 normalDelta = bHasNormals ? Vec3{&normalDeltas[v * 3]} : Vec3{0.f, 0.f, 0.f};
+            if (positionDelta.IsZeroVec() && normalDelta.IsZeroVec())
+            {
+                continue;
+            }
+
+            target.vertices.push_back(v);
+            target.positionDeltas.push_back(positionDelta);
+            if (bHasNormals)
+            {
+                target.normalDeltas.push_back(normalDelta);
+            }
+        }
+    }
+
+    // Default weights live in the mesh, shared by all its primitives
+    std::vector<float>& defaultWeights = outMesh.GetDefaultMorphWeights();
+    defaultWeights.assign(numTargets, 0.f);
+    for (unsigned int t = 0; t < numTargets && t < mesh.weights_count; ++t)
+    {
+        defaultWeights[t] = mesh.weights[t];
+    }
     
+} // MorphTargetsFromPrimitive
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+std::vector<SkeletalMesh> GLTFLoader::LoadMeshes(const cgltf_data* data, bool bMustHaveSkin, unsigned numThreads,
+    std::vector<int>* outSkinIndices)
+{
     const cgltf_node* nodes = data->nodes;
     const unsigned int nodeCount = data->nodes_count;
+
+    // Gather every primitive first, meshes are created here since their GL objects belong to this thread
+    std::vector<std::vector<int>> skinJointNodes(nodeCount);
+    if (outSkinIndices != nullptr)
+    {
+        outSkinIndices->clear();
+    }
+
+    std::vector<std::pair<unsigned int, const cgltf_primitive*>> primitives;
     for (unsigned int i = 0; i < nodeCount; ++i)
     {
         const cgltf_node& node = nodes[i];
@@ -368,32 +797,45 @@ std::vector<SkeletalMesh> GLTFLoader::LoadMeshes(const cgltf_data* data, bool bM
             continue;
         }
         
+        skinJointNodes[i] = GetSkinJointNodes(node.skin, nodes, nodeCount);
         for (unsigned int j = 0; j < node.mesh->primitives_count; ++j)
         {
-            result.emplace_back();
-            SkeletalMesh& skeletalMesh = result[result.size() - 1];
-            
-            const cgltf_primitive& primitive = node.mesh->primitives[j];
-            for (unsigned int k = 0; k < primitive.attributes_count; ++k)
+            primitives.emplace_back(i, &node.mesh->primitives[j]);
+            if (outSkinIndices != nullptr)
             {
-                const cgltf_attribute& attribute = primitive.attributes[k];
-                MeshFromAttribute(skeletalMesh, attribute, node.skin, nodes, nodeCount);
+                outSkinIndices->push_back(node.skin == nullptr ? -1 : static_cast<int>(node.skin - data->skins));
             }
+        }
+    }
 
-            if (primitive.indices != nullptr)
-            {
-                const unsigned int indicesCount = primitive.indices->count;
-                std::vector<unsigned int>& indices = skeletalMesh.GetIndices();
-                indices.resize(indicesCount);
-            
-                for (unsigned int k = 0; k < indicesCount; ++k)
-                {
-                    indices[k] = cgltf_accessor_read_index(primitive.indices, k);
-                } 
-            }
+    const unsigned int numMeshes = primitives.size();
+    std::vector<SkeletalMesh> result(numMeshes);
+
+    // Decoding and optimizing only touch CPU side data
+    GLTFHelpers::ParallelFor(numMeshes, numThreads, [&](unsigned int i)
+    {
+        SkeletalMesh& skeletalMesh = result[i];
+        const std::vector<int>& meshSkinJoints = skinJointNodes[primitives[i].first];
+        const cgltf_primitive& primitive = *primitives[i].second;
+        
+        for (unsigned int k = 0; k < primitive.attributes_count; ++k)
+        {
+            const cgltf_attribute& attribute = primitive.attributes[k];
+            MeshFromAttribute(skeletalMesh, attribute, meshSkinJoints);
+        }
+        MorphTargetsFromPrimitive(skeletalMesh, primitive, *nodes[primitives[i].first].mesh);
 
-            skeletalMesh.UpdateOpenGLBuffers();
+        if (primitive.indices != nullptr)
+        {
+            GetIndexValues(skeletalMesh.GetIndices(), *primitive.indices);
         }
+
+        MeshOptimizer::Optimize(skeletalMesh);
+    });
+
+    for (const SkeletalMesh& skeletalMesh : result)
+    {
+        skeletalMesh.UpdateOpenGLBuffers();
     }
 
     return result;
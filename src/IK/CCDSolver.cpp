@@ -38,6 +38,7 @@ float CCDSolver::GetThreshold() const
 void CCDSolver::Resize(unsigned newSize)
 {
     m_IKChain.resize(newSize);
+    m_Constraints.resize(newSize);
     
 } // Resize
 
@@ -59,6 +60,78 @@ void CCDSolver::SetThreshold(float threshold)
 
 // ---------------------------------------------------------------------------------------------------------------------
 
+void CCDSolver::SetConstraint(unsigned idx, const IKConstraint& constraint)
+{
+    m_Constraints[idx] = constraint;
+    
+} // SetConstraint
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+const IKConstraint& CCDSolver::GetConstraint(unsigned idx) const
+{
+    return m_Constraints[idx];
+    
+} // GetConstraint
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void CCDSolver::SetWarmStart(bool bWarmStart)
+{
+    m_WarmStart.SetEnabled(bWarmStart);
+    
+} // SetWarmStart
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+bool CCDSolver::IsWarmStarting() const
+{
+    return m_WarmStart.IsEnabled();
+    
+} // IsWarmStarting
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void CCDSolver::SetEarlyOutDistance(float distance)
+{
+    m_WarmStart.SetEarlyOutDistance(distance);
+    
+} // SetEarlyOutDistance
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+float CCDSolver::GetEarlyOutDistance() const
+{
+    return m_WarmStart.GetEarlyOutDistance();
+    
+} // GetEarlyOutDistance
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+unsigned CCDSolver::GetLastNumIterations() const
+{
+    return m_WarmStart.GetLastNumIterations();
+    
+} // GetLastNumIterations
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+const IKSolverStats& CCDSolver::GetStats() const
+{
+    return m_WarmStart.GetStats();
+    
+} // GetStats
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void CCDSolver::ResetStats()
+{
+    m_WarmStart.ResetStats();
+    
+} // ResetStats
+
+// ---------------------------------------------------------------------------------------------------------------------
+
 const Transform& CCDSolver::operator[](unsigned idx) const
 {
     return m_IKChain[idx];
@@ -95,29 +168,63 @@ bool CCDSolver::Solve(const Transform& target)
         return false;
     }
 
+    if (m_WarmStart.Restore(m_IKChain, target.position))
+    {
+        return m_WarmStart.RecordEarlyOut();
+    }
+
+    unsigned int numIterations = 0;
+    const bool bReached = Iterate(target.position, numIterations);
+    m_WarmStart.RecordSolve(m_IKChain, target.position, bReached, numIterations);
+    return bReached;
+    
+} // Solve
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+bool CCDSolver::Iterate(const Vec3& goal, unsigned& outNumIterations)
+{
     const unsigned int size = GetSize();
     const unsigned int lastIdx = size - 1;
     const float thresholdSq = m_Threshold * m_Threshold;
-    const Vec3& goal = target.position;
     
-    auto HasReachedGoal = [&]() -> bool
+    auto HasReachedGoal = [&](const Vec3& effectorPos) -> bool
     {
-        const Vec3 effectorPos = GetGlobalTransform(lastIdx).position;
         return (goal - effectorPos).LenSq() < thresholdSq;
     };
 
-    if (HasReachedGoal())
+    // World transform of every joint, joints are only rotated from the end so the ones before j are always valid
+    m_WorldChain.resize(size);
+    auto UpdateWorldChain = [&]()
+    {
+        m_WorldChain[0] = m_IKChain[0];
+        for (unsigned int k = 1; k < size; ++k)
+        {
+            m_WorldChain[k] = m_WorldChain[k - 1].Combine(m_IKChain[k]);
+        }
+    };
+
+    UpdateWorldChain();
+    if (HasReachedGoal(m_WorldChain[lastIdx].position))
     {
         return true;
     }
         
     for (unsigned int i = 0; i < m_NumSteps; ++i)
     {
+        if (i > 0)
+        {
+            UpdateWorldChain();
+        }
+
+        // Effector relative to the joint being rotated, it only grows by one joint per step
+        Transform effectorInJoint = m_IKChain[lastIdx];
+        
         for (int j = static_cast<int>(size - 2); j >= 0; --j)
         {
-           const Vec3 effectorPos = GetGlobalTransform(lastIdx).position;
+            const Transform& jointWorldTransform = m_WorldChain[j];
+            const Vec3 effectorPos = jointWorldTransform.Combine(effectorInJoint).position;
             
-            const Transform jointWorldTransform = GetGlobalTransform(j);
             const Vec3 toEffector = effectorPos - jointWorldTransform.position;
             const Vec3 toGoal = goal - jointWorldTransform.position;
 
@@ -127,19 +234,26 @@ bool CCDSolver::Solve(const Transform& target)
             // Rotate joint in world space then back to joint space
             const Quat worldRotated = jointWorldTransform.rotation * effectorToGoal;
             const Quat localRotated = worldRotated * jointWorldTransform.rotation.Inverse();
-            m_IKChain[j].rotation = localRotated * m_IKChain[j].rotation;
+            m_IKChain[j].rotation = m_Constraints[j].Apply(localRotated * m_IKChain[j].rotation);
 
+            // Only this joint and the ones after it moved
+            m_WorldChain[j] = j > 0 ? m_WorldChain[j - 1].Combine(m_IKChain[j]) : m_IKChain[j];
+            
             // We don't need to rotate all joints
-            if (HasReachedGoal())
+            if (HasReachedGoal(m_WorldChain[j].Combine(effectorInJoint).position))
             {
+                outNumIterations = i + 1;
                 return true;
             }
+
+            effectorInJoint = m_IKChain[j].Combine(effectorInJoint);
         }
     }
 
     // Check from last iteration
+    outNumIterations = m_NumSteps;
     return false;
     
-} // Solve
+} // Iterate
 
-// ---------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
\ No newline at end of file
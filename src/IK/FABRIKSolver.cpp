@@ -1,5 +1,7 @@
 ﻿#include "IK/FABRIKSolver.h"
 
+#include <algorithm>
+
 #include "Core/Transform.h"
 
 // ---------------------------------------------------------------------------------------------------------------------
@@ -72,6 +74,7 @@ void FABRIKSolver::Resize(unsigned newSize)
     m_IKChain.resize(newSize);
     m_WorldChain.resize(newSize);
     m_Lengths.resize(newSize);
+    m_Constraints.resize(newSize);
     
 } // Resize
 
@@ -101,6 +104,78 @@ void FABRIKSolver::SetLocalTransform(unsigned idx, const Transform& t)
 
 // ---------------------------------------------------------------------------------------------------------------------
 
+void FABRIKSolver::SetConstraint(unsigned idx, const IKConstraint& constraint)
+{
+    m_Constraints[idx] = constraint;
+    
+} // SetConstraint
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+const IKConstraint& FABRIKSolver::GetConstraint(unsigned idx) const
+{
+    return m_Constraints[idx];
+    
+} // GetConstraint
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void FABRIKSolver::SetWarmStart(bool bWarmStart)
+{
+    m_WarmStart.SetEnabled(bWarmStart);
+    
+} // SetWarmStart
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+bool FABRIKSolver::IsWarmStarting() const
+{
+    return m_WarmStart.IsEnabled();
+    
+} // IsWarmStarting
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void FABRIKSolver::SetEarlyOutDistance(float distance)
+{
+    m_WarmStart.SetEarlyOutDistance(distance);
+    
+} // SetEarlyOutDistance
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+float FABRIKSolver::GetEarlyOutDistance() const
+{
+    return m_WarmStart.GetEarlyOutDistance();
+    
+} // GetEarlyOutDistance
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+unsigned FABRIKSolver::GetLastNumIterations() const
+{
+    return m_WarmStart.GetLastNumIterations();
+    
+} // GetLastNumIterations
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+const IKSolverStats& FABRIKSolver::GetStats() const
+{
+    return m_WarmStart.GetStats();
+    
+} // GetStats
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void FABRIKSolver::ResetStats()
+{
+    m_WarmStart.ResetStats();
+    
+} // ResetStats
+
+// ---------------------------------------------------------------------------------------------------------------------
+
 Transform FABRIKSolver::GetGlobalTransform(unsigned idx) const
 {
     Transform worldTransform = m_IKChain[idx];
@@ -121,45 +196,65 @@ bool FABRIKSolver::Solve(const Transform& target)
         return false;
     }
 
+    if (m_WarmStart.Restore(m_IKChain, target.position))
+    {
+        return m_WarmStart.RecordEarlyOut();
+    }
+
+    unsigned int numIterations = 0;
+    const bool bReached = Iterate(target.position, numIterations);
+    m_WarmStart.RecordSolve(m_IKChain, target.position, bReached, numIterations);
+    return bReached;
+    
+} // Solve
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+bool FABRIKSolver::Iterate(const Vec3& goal, unsigned& outNumIterations)
+{
     const unsigned int size = GetSize();
     const unsigned int lastIdx = size - 1;
     const float thresholdSq = m_Threshold * m_Threshold;
-    const Vec3& goal = target.position;
 
     auto HasReachedGoal = [&](const Vec3& effectorPos) -> bool
     {
         return (goal - effectorPos).LenSq() < thresholdSq;
     };
 
-    if (HasReachedGoal(GetGlobalTransform(lastIdx).position))
+    IKChainToWorld();
+    if (HasReachedGoal(m_WorldChain[lastIdx]))
     {
         return true;
     }
 
-    IKChainToWorld();
     const Vec3 base = m_WorldChain[0];
+    const bool bHasConstraints = std::any_of(m_Constraints.begin(), m_Constraints.end(),
+        [](const IKConstraint& constraint) { return constraint.GetType() != IKConstraintType::None; });
 
     for (unsigned int i = 0; i < m_NumSteps; ++i)
     {
         IterateBackwards(goal);
         IterateForward(base);
 
-        // Check constrains
-        WorldToIKChain();
-        // Constrains
-        IKChainToWorld();
+        // Unconstrained chains only need rotations once solved
+        if (bHasConstraints)
+        {
+            WorldToIKChain();
+        }
 
         if (HasReachedGoal(m_WorldChain[lastIdx]))
         {
             WorldToIKChain();
+            outNumIterations = i + 1;
             return true;
         }
     }
 
     WorldToIKChain();
+    outNumIterations = m_NumSteps;
     return false;
     
-} // Solve
+} // Iterate
 
 // ---------------------------------------------------------------------------------------------------------------------
 
@@ -170,13 +265,16 @@ void FABRIKSolver::IKChainToWorld()
         return;
     }
 
-    m_WorldChain[0] = GetGlobalTransform(0).position;
+    // Each link's world transform extends the previous one
+    Transform worldTransform = m_IKChain[0];
+    m_WorldChain[0] = worldTransform.position;
     m_Lengths[0] = 0.f;
     
     const unsigned int size = GetSize();
     for (unsigned int i = 1; i < size; ++i)
     {
-        m_WorldChain[i] = GetGlobalTransform(i).position;
+        worldTransform = worldTransform.Combine(m_IKChain[i]);
+        m_WorldChain[i] = worldTransform.position;
         m_Lengths[i] = (m_WorldChain[i] - m_WorldChain[i - 1]).Len();
     }
     
@@ -233,11 +331,14 @@ void FABRIKSolver::WorldToIKChain()
         return;
     }
 
+    // World transform of the parent of the current link, already including the rotations applied this pass
+    Transform parentTransform;
+    
     const unsigned int size = GetSize();
     for (unsigned int i = 0; i < size - 1; ++i)
     {
-        const Transform currentTransform = GetGlobalTransform(i);
-        const Transform nextTransform = GetGlobalTransform(i + 1);
+        const Transform currentTransform = parentTransform.Combine(m_IKChain[i]);
+        const Transform nextTransform = currentTransform.Combine(m_IKChain[i + 1]);
 
         // Apply rotation from current to desired rotation
         const Quat currentRotInverse = currentTransform.rotation.Inverse();
@@ -245,7 +346,11 @@ void FABRIKSolver::WorldToIKChain()
         const Vec3 toDesired = currentRotInverse * (m_WorldChain[i + 1] - currentTransform.position);
 
         const Quat moveRot = Quat::FromTo(toNext, toDesired);
-        m_IKChain[i].rotation = moveRot * m_IKChain[i].rotation;
+        m_IKChain[i].rotation = m_Constraints[i].Apply(moveRot * m_IKChain[i].rotation);
+        parentTransform = parentTransform.Combine(m_IKChain[i]);
+
+        // A constrained link may not reach the desired position, the next iteration starts from where it ended
+        m_WorldChain[i + 1] = parentTransform.Combine(m_IKChain[i + 1]).position;
     }
     
 } // WorldToIKChain
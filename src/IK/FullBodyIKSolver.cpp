@@ -0,0 +1,598 @@
+﻿#include "IK/FullBodyIKSolver.h"
+
+#include <cmath>
+#include <iostream>
+
+#include "SkeletalMesh/Pose.h"
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+namespace FullBodyIKHelpers
+{
+    // Moves "from" along the direction towards "to" so it ends up at length, keeps fallback if they overlap
+    inline Vec3 PlaceAtLength(const Vec3& from, const Vec3& to, float length, const Vec3& fallback)
+    {
+        const Vec3 direction = to - from;
+        const float lenSq = direction.LenSq();
+        return lenSq > 1e-12f ? from + direction * (length / sqrtf(lenSq)) : fallback;
+    }
+    
+} // FullBodyIKHelpers
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+FullBodyIKSolver::FullBodyIKSolver()
+{
+    
+} // FullBodyIKSolver
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+unsigned FullBodyIKSolver::GetRoot() const
+{
+    return m_Root;
+    
+} // GetRoot
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+unsigned FullBodyIKSolver::GetNumEffectors() const
+{
+    return m_Effectors.size();
+    
+} // GetNumEffectors
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+const IKEffector& FullBodyIKSolver::GetEffector(unsigned idx) const
+{
+    return m_Effectors[idx];
+    
+} // GetEffector
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+unsigned FullBodyIKSolver::GetNumSteps() const
+{
+    return m_NumSteps;
+    
+} // GetNumSteps
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+float FullBodyIKSolver::GetThreshold() const
+{
+    return m_Threshold;
+    
+} // GetThreshold
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+unsigned FullBodyIKSolver::GetLastNumIterations() const
+{
+    return m_LastNumIterations;
+    
+} // GetLastNumIterations
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+const IKSolverStats& FullBodyIKSolver::GetStats() const
+{
+    return m_Stats;
+    
+} // GetStats
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void FullBodyIKSolver::SetRoot(unsigned rootIdx)
+{
+    m_Root = rootIdx;
+    m_bDirty = true;
+    
+} // SetRoot
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+unsigned FullBodyIKSolver::AddEffector(unsigned jointIdx, float weight)
+{
+    IKEffector effector;
+    effector.joint = jointIdx;
+    effector.weight = weight;
+    m_Effectors.push_back(effector);
+    m_bDirty = true;
+    
+    return m_Effectors.size() - 1;
+    
+} // AddEffector
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void FullBodyIKSolver::SetEffectorTarget(unsigned idx, const Vec3& target)
+{
+    m_Effectors[idx].target = target;
+    
+} // SetEffectorTarget
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void FullBodyIKSolver::SetEffectorWeight(unsigned idx, float weight)
+{
+    m_Effectors[idx].weight = weight;
+    if (!m_bDirty)
+    {
+        UpdateWeights();
+    }
+    
+} // SetEffectorWeight
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void FullBodyIKSolver::ClearEffectors()
+{
+    m_Effectors.clear();
+    m_bDirty = true;
+    
+} // ClearEffectors
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void FullBodyIKSolver::SetNumSteps(unsigned numSteps)
+{
+    m_NumSteps = numSteps;
+    
+} // SetNumSteps
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void FullBodyIKSolver::SetThreshold(float threshold)
+{
+    m_Threshold = threshold;
+    
+} // SetThreshold
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void FullBodyIKSolver::ResetStats()
+{
+    m_Stats = {};
+    
+} // ResetStats
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+bool FullBodyIKSolver::Solve(Pose& pose, const Transform& model)
+{
+    if (m_bDirty || m_PoseSize != pose.GetSize())
+    {
+        BuildTree(pose);
+    }
+
+    if (m_Joints.size() < 2)
+    {
+        return false;
+    }
+
+    GatherPositions(pose, model);
+
+    unsigned int numIterations = 0;
+    bool bReached = HasReachedTargets();
+    if (!bReached)
+    {
+        const Vec3 base = m_Positions[0];
+        for (unsigned int i = 0; i < m_NumSteps && !bReached; ++i)
+        {
+            IterateBackwards();
+            IterateForward(base);
+            bReached = HasReachedTargets();
+            ++numIterations;
+        }
+
+        WorldToPose(pose);
+    }
+
+    m_LastNumIterations = numIterations;
+    ++m_Stats.numSolves;
+    m_Stats.numIterations += numIterations;
+    m_Stats.numReached += bReached ? 1 : 0;
+    
+    return bReached;
+    
+} // Solve
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void FullBodyIKSolver::BuildTree(const Pose& pose)
+{
+    m_bDirty = false;
+    m_PoseSize = pose.GetSize();
+    m_Joints.clear();
+    m_Parents.clear();
+    m_Children.clear();
+    m_NodeEffectors.clear();
+    m_EffectorNodes.assign(GetNumEffectors(), -1);
+    m_Weights.clear();
+
+    if (m_Root >= m_PoseSize)
+    {
+        return;
+    }
+
+    // Node of every pose joint in the tree
+    std::vector<int> jointNodes(m_PoseSize, -1);
+    auto AddNode = [&](unsigned int joint, int parentNode)
+    {
+        jointNodes[joint] = static_cast<int>(m_Joints.size());
+        m_Joints.push_back(joint);
+        m_Parents.push_back(parentNode);
+        m_Children.emplace_back();
+        m_NodeEffectors.push_back(-1);
+        if (parentNode >= 0)
+        {
+            m_Children[parentNode].push_back(m_Joints.size() - 1);
+        }
+    };
+    AddNode(m_Root, -1);
+
+    // Add the path from the root down to each effector, the nodes already in the tree are shared
+    std::vector<unsigned int> path;
+    const unsigned int numEffectors = GetNumEffectors();
+    for (unsigned int i = 0; i < numEffectors; ++i)
+    {
+        path.clear();
+        int joint = static_cast<int>(m_Effectors[i].joint);
+        while (joint >= 0 && joint != static_cast<int>(m_Root))
+        {
+            path.push_back(joint);
+            joint = pose.GetParent(joint);
+        }
+        
+        if (joint < 0 || path.empty())
+        {
+            std::cout << "IK effector on joint " << m_Effectors[i].joint << " is not below the root " << m_Root
+                << std::endl;
+            continue;
+        }
+
+        for (auto it = path.rbegin(); it != path.rend(); ++it)
+        {
+            if (jointNodes[*it] < 0)
+            {
+                AddNode(*it, jointNodes[pose.GetParent(*it)]);
+            }
+        }
+
+        const int node = jointNodes[m_Effectors[i].joint];
+        m_NodeEffectors[node] = static_cast<int>(i);
+        m_EffectorNodes[i] = node;
+    }
+
+    UpdateWeights();
+    
+} // BuildTree
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void FullBodyIKSolver::UpdateWeights()
+{
+    m_Weights.assign(m_Joints.size(), 0.f);
+
+    // Effector weights add up along the path so branches know how much they pull on their sub-base
+    const unsigned int numEffectors = m_EffectorNodes.size();
+    for (unsigned int i = 0; i < numEffectors; ++i)
+    {
+        for (int node = m_EffectorNodes[i]; node >= 0; node = m_Parents[node])
+        {
+            m_Weights[node] += m_Effectors[i].weight;
+        }
+    }
+    
+} // UpdateWeights
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void FullBodyIKSolver::GatherPositions(const Pose& pose, const Transform& model)
+{
+    const unsigned int size = m_Joints.size();
+    m_World.resize(size);
+    m_Positions.resize(size);
+    m_Lengths.resize(size);
+    m_Offsets.resize(size);
+
+    // One walk up for the root, the rest of the tree is built from the locals
+    const int rootParent = pose.GetParent(m_Root);
+    m_RootParentWorld = rootParent >= 0 ? model.Combine(pose.GetGlobalTransform(rootParent)) : model;
+    m_World[0] = m_RootParentWorld.Combine(pose.GetLocalTransform(m_Root));
+    m_Positions[0] = m_World[0].position;
+    m_Lengths[0] = 0.f;
+    m_Offsets[0] = Vec3();
+
+    for (unsigned int i = 1; i < size; ++i)
+    {
+        m_World[i] = m_World[m_Parents[i]].Combine(pose.GetLocalTransform(m_Joints[i]));
+        m_Positions[i] = m_World[i].position;
+        m_Offsets[i] = m_Positions[i] - m_Positions[m_Parents[i]];
+        m_Lengths[i] = m_Offsets[i].Len();
+    }
+    
+} // GatherPositions
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+bool FullBodyIKSolver::HasReachedTargets() const
+{
+    const float thresholdSq = m_Threshold * m_Threshold;
+    const unsigned int size = m_Joints.size();
+    for (unsigned int i = 0; i < size; ++i)
+    {
+        const int effector = m_NodeEffectors[i];
+        if (effector >= 0 && (m_Effectors[effector].target - m_Positions[i]).LenSq() >= thresholdSq)
+        {
+            return false;
+        }
+    }
+
+    return true;
+    
+} // HasReachedTargets
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void FullBodyIKSolver::IterateBackwards()
+{
+    // Children first: effectors go to their target, chain joints stay at bone length from their child and sub-bases
+    // move with their children rigidly, as their offsets from it can't change
+    for (int i = static_cast<int>(m_Joints.size()) - 1; i >= 0; --i)
+    {
+        const std::vector<unsigned int>& children = m_Children[i];
+        const int effector = m_NodeEffectors[i];
+        if (effector >= 0)
+        {
+            m_Positions[i] = m_Effectors[effector].target;
+        }
+        else if (children.size() == 1)
+        {
+            const unsigned int child = children[0];
+            m_Positions[i] = FullBodyIKHelpers::PlaceAtLength(m_Positions[child], m_Positions[i], m_Lengths[child],
+                m_Positions[child] - m_Offsets[child]);
+            m_Offsets[child] = m_Positions[child] - m_Positions[i];
+        }
+        else if (children.size() > 1)
+        {
+            // Fit the offsets around their centroid to the children around theirs
+            Vec3 offsetCentroid;
+            Vec3 childCentroid;
+            float weightSum = 0.f;
+            for (unsigned int child : children)
+            {
+                offsetCentroid += m_Offsets[child] * m_Weights[child];
+                childCentroid += m_Positions[child] * m_Weights[child];
+                weightSum += m_Weights[child];
+            }
+            
+            if (weightSum <= 0.f)
+            {
+                continue;
+            }
+            offsetCentroid = offsetCentroid / weightSum;
+            childCentroid = childCentroid / weightSum;
+
+            m_FitFrom.clear();
+            m_FitTo.clear();
+            m_FitWeights.clear();
+            for (unsigned int child : children)
+            {
+                m_FitFrom.push_back(m_Offsets[child] - offsetCentroid);
+                m_FitTo.push_back(m_Positions[child] - childCentroid);
+                m_FitWeights.push_back(m_Weights[child]);
+            }
+
+            const Quat rotation = FitRotation();
+            m_Positions[i] = childCentroid - rotation * offsetCentroid;
+            for (unsigned int child : children)
+            {
+                m_Offsets[child] = rotation * m_Offsets[child];
+            }
+        }
+    }
+    
+} // IterateBackwards
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void FullBodyIKSolver::IterateForward(const Vec3& base)
+{
+    m_Positions[0] = base;
+
+    // Parents first: chain joints are pulled to bone length, sub-bases rotate their offsets towards their children
+    const unsigned int size = m_Joints.size();
+    for (unsigned int i = 0; i < size; ++i)
+    {
+        const std::vector<unsigned int>& children = m_Children[i];
+        if (children.size() == 1)
+        {
+            const unsigned int child = children[0];
+            m_Positions[child] = FullBodyIKHelpers::PlaceAtLength(m_Positions[i], m_Positions[child],
+                m_Lengths[child], m_Positions[i] + m_Offsets[child]);
+            m_Offsets[child] = m_Positions[child] - m_Positions[i];
+        }
+        else if (children.size() > 1)
+        {
+            m_FitFrom.clear();
+            m_FitTo.clear();
+            m_FitWeights.clear();
+            for (unsigned int child : children)
+            {
+                m_FitFrom.push_back(m_Offsets[child]);
+                m_FitTo.push_back(m_Positions[child] - m_Positions[i]);
+                m_FitWeights.push_back(m_Weights[child]);
+            }
+
+            const Quat rotation = FitRotation();
+            for (unsigned int child : children)
+            {
+                m_Offsets[child] = rotation * m_Offsets[child];
+                m_Positions[child] = m_Positions[i] + m_Offsets[child];
+            }
+        }
+    }
+    
+} // IterateForward
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+Quat FullBodyIKSolver::FitRotation() const
+{
+    // Horn's method: the best rotation is the eigenvector with the largest eigenvalue of a symmetric 4x4 matrix built
+    // from the weighted cross covariance. Sub-base offsets are often coplanar, so it's found with Jacobi rotations
+    // which stay exact for degenerate sets instead of an iterative fit
+    float s[3][3] = {};
+    const unsigned int count = m_FitFrom.size();
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        const Vec3 from = m_FitFrom[i] * m_FitWeights[i];
+        const Vec3& to = m_FitTo[i];
+        for (int a = 0; a < 3; ++a)
+        {
+            for (int b = 0; b < 3; ++b)
+            {
+                s[a][b] += from[a] * to[b];
+            }
+        }
+    }
+
+    float n[4][4] =
+    {
+        {s[0][0] + s[1][1] + s[2][2], s[1][2] - s[2][1], s[2][0] - s[0][2], s[0][1] - s[1][0]},
+        {s[1][2] - s[2][1], s[0][0] - s[1][1] - s[2][2], s[0][1] + s[1][0], s[2][0] + s[0][2]},
+        {s[2][0] - s[0][2], s[0][1] + s[1][0], -s[0][0] + s[1][1] - s[2][2], s[1][2] + s[2][1]},
+        {s[0][1] - s[1][0], s[2][0] + s[0][2], s[1][2] + s[2][1], -s[0][0] - s[1][1] + s[2][2]},
+    };
+    float v[4][4] = {{1.f, 0.f, 0.f, 0.f}, {0.f, 1.f, 0.f, 0.f}, {0.f, 0.f, 1.f, 0.f}, {0.f, 0.f, 0.f, 1.f}};
+
+    static constexpr int MAX_SWEEPS = 10;
+    for (int sweep = 0; sweep < MAX_SWEEPS; ++sweep)
+    {
+        float offDiagonal = 0.f;
+        float diagonal = 0.f;
+        for (int p = 0; p < 4; ++p)
+        {
+            diagonal += n[p][p] * n[p][p];
+            for (int q = p + 1; q < 4; ++q)
+            {
+                offDiagonal += n[p][q] * n[p][q];
+            }
+        }
+        
+        if (offDiagonal <= 1e-14f * diagonal || offDiagonal < 1e-30f)
+        {
+            break;
+        }
+
+        // Zero every off diagonal element in turn, n = J^T n J and v = v J
+        for (int p = 0; p < 3; ++p)
+        {
+            for (int q = p + 1; q < 4; ++q)
+            {
+                if (std::abs(n[p][q]) < 1e-30f)
+                {
+                    continue;
+                }
+
+                const float theta = (n[q][q] - n[p][p]) / (2.f * n[p][q]);
+                const float t = (theta >= 0.f ? 1.f : -1.f) / (std::abs(theta) + sqrtf(theta * theta + 1.f));
+                const float c = 1.f / sqrtf(t * t + 1.f);
+                const float sn = t * c;
+                for (int k = 0; k < 4; ++k)
+                {
+                    const float kp = n[k][p];
+                    const float kq = n[k][q];
+                    n[k][p] = c * kp - sn * kq;
+                    n[k][q] = sn * kp + c * kq;
+                }
+                for (int k = 0; k < 4; ++k)
+                {
+                    const float pk = n[p][k];
+                    const float qk = n[q][k];
+                    n[p][k] = c * pk - sn * qk;
+                    n[q][k] = sn * pk + c * qk;
+                }
+                for (int k = 0; k < 4; ++k)
+                {
+                    const float kp = v[k][p];
+                    const float kq = v[k][q];
+                    v[k][p] = c * kp - sn * kq;
+                    v[k][q] = sn * kp + c * kq;
+                }
+            }
+        }
+    }
+
+    int best = 0;
+    for (int i = 1; i < 4; ++i)
+    {
+        if (n[i][i] > n[best][best])
+        {
+            best = i;
+        }
+    }
+
+    // Eigenvector is (w, x, y, z)
+    const float lenSq = v[0][best] * v[0][best] + v[1][best] * v[1][best] + v[2][best] * v[2][best] +
+        v[3][best] * v[3][best];
+    const float invLen = lenSq > 0.f ? 1.f / sqrtf(lenSq) : 0.f;
+    return lenSq > 0.f ? Quat(v[1][best] * invLen, v[2][best] * invLen, v[3][best] * invLen, v[0][best] * invLen)
+        : Quat();
+    
+} // FitRotation
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void FullBodyIKSolver::WorldToPose(Pose& pose)
+{
+    const unsigned int size = m_Joints.size();
+    for (unsigned int i = 0; i < size; ++i)
+    {
+        const std::vector<unsigned int>& children = m_Children[i];
+        const unsigned int joint = m_Joints[i];
+        Transform local = pose.GetLocalTransform(joint);
+        
+        // Parents are already rotated, rebuild this joint on top of them
+        const Transform& parentWorld = i > 0 ? m_World[m_Parents[i]] : m_RootParentWorld;
+        Transform& world = m_World[i];
+        world = parentWorld.Combine(local);
+        if (children.empty())
+        {
+            continue;
+        }
+
+        // Solved offsets are rigid rotations of the current ones, a single child is matched exactly
+        Quat delta;
+        if (children.size() == 1)
+        {
+            const unsigned int child = children[0];
+            const Vec3 from = world.Combine(pose.GetLocalTransform(m_Joints[child])).position - world.position;
+            delta = Quat::FromTo(from, m_Positions[child] - m_Positions[i]);
+        }
+        else
+        {
+            m_FitFrom.clear();
+            m_FitTo.clear();
+            m_FitWeights.clear();
+            for (unsigned int child : children)
+            {
+                m_FitFrom.push_back(world.Combine(pose.GetLocalTransform(m_Joints[child])).position - world.position);
+                m_FitTo.push_back(m_Positions[child] - m_Positions[i]);
+                m_FitWeights.push_back(m_Weights[child]);
+            }
+            delta = FitRotation();
+        }
+
+        // World rotation then back to local
+        world.rotation = world.rotation * delta;
+        local.rotation = world.rotation * parentWorld.rotation.Inverse();
+        pose.SetLocalTransform(joint, local);
+    }
+    
+} // WorldToPose
+
+// ---------------------------------------------------------------------------------------------------------------------
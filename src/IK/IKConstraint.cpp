@@ -0,0 +1,168 @@
+﻿#include "IK/IKConstraint.h"
+
+#include <cmath>
+
+#include "Core/Quat.h"
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+namespace IKConstraintHelpers
+{
+    // Signed angle of q around axis, in [-PI, PI]
+    inline float GetAngleAround(const Quat& q, const Vec3& axis)
+    {
+        float angle = 2.f * atan2f(q.vector | axis, q.scalar);
+        if (angle > PI)
+        {
+            angle -= 2.f * PI;
+        }
+        else if (angle < -PI)
+        {
+            angle += 2.f * PI;
+        }
+        return angle;
+    }
+
+    // Splits q into the rotation around axis (applied first, axis is in q's own space) and the swing after it
+    inline void DecomposeSwingTwist(const Quat& q, const Vec3& axis, Quat& outSwing, Quat& outTwist)
+    {
+        const Vec3 projected = axis * (q.vector | axis);
+        outTwist = {projected, q.scalar};
+        if (outTwist.LenSq() < 1e-8f)
+        {
+            // 180 degrees swing, there's no twist to extract
+            outTwist = {};
+        }
+        else
+        {
+            outTwist = outTwist * (1.f / sqrtf(outTwist.LenSq()));
+        }
+        outSwing = outTwist.Inverse() * q;
+    }
+    
+} // IKConstraintHelpers
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+IKConstraint::IKConstraint()
+{
+    
+} // IKConstraint
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+IKConstraint IKConstraint::Hinge(const Vec3& axis, float minAngle, float maxAngle)
+{
+    IKConstraint result;
+    result.m_Type = IKConstraintType::Hinge;
+    result.m_Axis = axis.Normalized();
+    result.m_MinAngle = minAngle;
+    result.m_MaxAngle = maxAngle;
+    return result;
+    
+} // Hinge
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+IKConstraint IKConstraint::BallSocket(const Vec3& boneAxis, const Vec3& coneAxis, float maxSwing, float minTwist,
+    float maxTwist)
+{
+    IKConstraint result;
+    result.m_Type = IKConstraintType::BallSocket;
+    result.m_BoneAxis = boneAxis.Normalized();
+    result.m_Axis = coneAxis.Normalized();
+    result.m_MaxSwing = maxSwing;
+    result.m_MinAngle = minTwist;
+    result.m_MaxAngle = maxTwist;
+    return result;
+    
+} // BallSocket
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+IKConstraint IKConstraint::Twist(const Vec3& boneAxis, float minTwist, float maxTwist)
+{
+    IKConstraint result;
+    result.m_Type = IKConstraintType::Twist;
+    result.m_BoneAxis = boneAxis.Normalized();
+    result.m_MinAngle = minTwist;
+    result.m_MaxAngle = maxTwist;
+    return result;
+    
+} // Twist
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+Quat IKConstraint::Apply(const Quat& localRotation) const
+{
+    switch (m_Type)
+    {
+        case IKConstraintType::Hinge:
+            return ApplyHinge(localRotation);
+        case IKConstraintType::BallSocket:
+            return ApplyBallSocket(localRotation);
+        case IKConstraintType::Twist:
+            return ApplyTwist(localRotation);
+        default:
+            return localRotation;
+    }
+    
+} // Apply
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+Quat IKConstraint::ApplyHinge(const Quat& localRotation) const
+{
+    // Remove the swing that moved the hinge axis, what's left only rotates around it
+    const Vec3 currentAxis = localRotation * m_Axis;
+    const Quat hinged = localRotation * Quat::FromTo(currentAxis, m_Axis);
+
+    const float angle = IKConstraintHelpers::GetAngleAround(hinged, m_Axis);
+    return Quat::CreateFromAxis(BasicUtils::Clamp(angle, m_MinAngle, m_MaxAngle), m_Axis);
+    
+} // ApplyHinge
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+Quat IKConstraint::ApplyBallSocket(const Quat& localRotation) const
+{
+    const Quat twisted = ApplyTwist(localRotation);
+    
+    const Vec3 boneDirection = twisted * m_BoneAxis;
+    if (Vec3::Angle(m_Axis, boneDirection) <= m_MaxSwing)
+    {
+        return twisted;
+    }
+
+    // Pull the bone back to the border of the cone, in the plane it left from
+    const Vec3 swingAxis = Quat::FromTo(m_Axis, boneDirection).GetAxis();
+    const Vec3 limitedDirection = Quat::CreateFromAxis(m_MaxSwing, swingAxis) * m_Axis;
+    return twisted * Quat::FromTo(boneDirection, limitedDirection);
+    
+} // ApplyBallSocket
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+Quat IKConstraint::ApplyTwist(const Quat& localRotation) const
+{
+    if (m_MinAngle <= -PI && m_MaxAngle >= PI)
+    {
+        return localRotation;
+    }
+    
+    Quat swing;
+    Quat twist;
+    IKConstraintHelpers::DecomposeSwingTwist(localRotation, m_BoneAxis, swing, twist);
+
+    const float angle = IKConstraintHelpers::GetAngleAround(twist, m_BoneAxis);
+    const float limitedAngle = BasicUtils::Clamp(angle, m_MinAngle, m_MaxAngle);
+    if (limitedAngle == angle)
+    {
+        return localRotation;
+    }
+
+    return Quat::CreateFromAxis(limitedAngle, m_BoneAxis) * swing;
+    
+} // ApplyTwist
+
+// ---------------------------------------------------------------------------------------------------------------------
@@ -1,16 +1,13 @@
 ﻿#include "IK/IKLeg.h"
 
 #include "Core/Transform.h"
-#include "Render/DebugDrawer.h"
+#include "IK/TwoBoneIKBatch.h"
 #include "SkeletalMesh/Skeleton.h"
 
 // ---------------------------------------------------------------------------------------------------------------------
 
-IKLeg::IKLeg() : m_LineVisuals(new DebugDrawer()), m_PointVisuals(new DebugDrawer())
+IKLeg::IKLeg()
 {
-    m_Solver.Resize(3);
-    m_PointVisuals->Resize(3);
-    m_LineVisuals->Resize(4);
     
 } // IKLeg
 
@@ -45,43 +42,6 @@ IKLeg::IKLeg(const Skeleton& skeleton, const std::string& hip, const std::string
 
 // ---------------------------------------------------------------------------------------------------------------------
 
-IKLeg::IKLeg(const IKLeg& other) : IKLeg()
-{
-    *this = other;
-    
-} // IKLeg
-
-// ---------------------------------------------------------------------------------------------------------------------
-
-IKLeg& IKLeg::operator=(const IKLeg& other)
-{
-    if (this == &other)
-    {
-        return *this;
-    }
-
-    m_Solver = other.m_Solver;
-    m_AnkleOffset = other.m_AnkleOffset;
-    m_HipIdx = other.m_HipIdx;
-    m_KneeIdx = other.m_KneeIdx;
-    m_AnkleIdx = other.m_AnkleIdx;
-    m_ToeIdx = other.m_ToeIdx;
-
-    return *this;
-    
-} // operator=
-
-// ---------------------------------------------------------------------------------------------------------------------
-
-IKLeg::~IKLeg()
-{
-    delete m_LineVisuals;
-    delete m_PointVisuals;
-    
-} // ~IKLeg
-
-// ---------------------------------------------------------------------------------------------------------------------
-
 void IKLeg::SolveForLeg(const Transform& model, const Pose& pose, const Vec3& ankleTargetPosition)
 {
     // Set solver with leg positions
@@ -90,6 +50,11 @@ void IKLeg::SolveForLeg(const Transform& model, const Pose& pose, const Vec3& an
     m_Solver.SetLocalTransform(2, pose.GetLocalTransform(m_AnkleIdx));
     m_IKPose = pose;
 
+    // Pole in front of the animated knee so the leg bends the same way even when it's straight
+    const Transform kneeWorld = m_Solver.GetGlobalTransform(1);
+    const float thighLength = (kneeWorld.position - m_Solver.GetLocalTransform(0).position).Len();
+    m_Solver.SetPoleVector(kneeWorld.position + (model.rotation * m_KneeDirection) * thighLength);
+
     const Transform target(ankleTargetPosition + Vec3{0, m_AnkleOffset, 0});
     m_Solver.Solve(target);
 
@@ -98,29 +63,24 @@ void IKLeg::SolveForLeg(const Transform& model, const Pose& pose, const Vec3& an
     m_IKPose.SetLocalTransform(m_HipIdx, rootWorld.Inverse().Combine(m_Solver.GetLocalTransform(0)));
     m_IKPose.SetLocalTransform(m_KneeIdx, m_Solver.GetLocalTransform(1));
     m_IKPose.SetLocalTransform(m_AnkleIdx, m_Solver.GetLocalTransform(2));
-
-    m_LineVisuals->LinesFromIKSolver(m_Solver);
-    m_PointVisuals->PointsFromIKSolver(m_Solver);
     
 } // SolveForLeg
 
 // ---------------------------------------------------------------------------------------------------------------------
 
-float IKLeg::GetPinValue(float alpha) const
+void IKLeg::AddToBatch(TwoBoneIKBatch& batch, const Transform& model, Pose& pose, const Vec3& ankleTargetPosition) const
 {
-    return m_PinTrack.Sample(alpha, true);
+    batch.AddChain(pose, model, m_HipIdx, m_KneeIdx, m_AnkleIdx, ankleTargetPosition + Vec3{0, m_AnkleOffset, 0},
+        model.rotation * m_KneeDirection);
     
-} // GetPinValue
+} // AddToBatch
 
 // ---------------------------------------------------------------------------------------------------------------------
 
-void IKLeg::Draw(const Mat4& mv, const Vec3& legColor) const
+float IKLeg::GetPinValue(float alpha) const
 {
-    m_LineVisuals->UpdateOpenGLBuffers();
-    m_PointVisuals->UpdateOpenGLBuffers();
-    m_LineVisuals->Draw(DebugDrawMode::Lines, legColor, mv);
-    m_PointVisuals->Draw(DebugDrawMode::Points, legColor, mv);
+    return m_PinTrack.Sample(alpha, true);
     
-} // Draw
+} // GetPinValue
 
 // ---------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,125 @@
+﻿#include "IK/IKWarmStart.h"
+
+#include "Core/Transform.h"
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+IKWarmStart::IKWarmStart()
+{
+    
+} // IKWarmStart
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void IKWarmStart::SetEnabled(bool bEnabled)
+{
+    m_bEnabled = bEnabled;
+    if (!m_bEnabled)
+    {
+        m_LastSolution.clear();
+    }
+    
+} // SetEnabled
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+bool IKWarmStart::IsEnabled() const
+{
+    return m_bEnabled;
+    
+} // IsEnabled
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void IKWarmStart::SetEarlyOutDistance(float distance)
+{
+    m_EarlyOutDistance = distance;
+    
+} // SetEarlyOutDistance
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+float IKWarmStart::GetEarlyOutDistance() const
+{
+    return m_EarlyOutDistance;
+    
+} // GetEarlyOutDistance
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+unsigned IKWarmStart::GetLastNumIterations() const
+{
+    return m_LastNumIterations;
+    
+} // GetLastNumIterations
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+const IKSolverStats& IKWarmStart::GetStats() const
+{
+    return m_Stats;
+    
+} // GetStats
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void IKWarmStart::ResetStats()
+{
+    m_Stats = {};
+    
+} // ResetStats
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+bool IKWarmStart::Restore(std::vector<Transform>& chain, const Vec3& goal) const
+{
+    if (!m_bEnabled || m_LastSolution.size() != chain.size())
+    {
+        return false;
+    }
+
+    // Only rotations are taken, the caller may have moved the root or changed the bone lengths
+    const unsigned int size = chain.size();
+    for (unsigned int i = 0; i < size; ++i)
+    {
+        chain[i].rotation = m_LastSolution[i].rotation;
+    }
+
+    const float earlyOutSq = m_EarlyOutDistance * m_EarlyOutDistance;
+    return (goal - m_LastTarget).LenSq() < earlyOutSq &&
+        (chain[0].position - m_LastSolution[0].position).LenSq() < earlyOutSq;
+    
+} // Restore
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+bool IKWarmStart::RecordEarlyOut()
+{
+    m_LastNumIterations = 0;
+    ++m_Stats.numSolves;
+    ++m_Stats.numEarlyOuts;
+    m_Stats.numReached += m_bLastReached ? 1 : 0;
+    return m_bLastReached;
+    
+} // RecordEarlyOut
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void IKWarmStart::RecordSolve(const std::vector<Transform>& chain, const Vec3& goal, bool bReached,
+    unsigned numIterations)
+{
+    m_LastNumIterations = numIterations;
+    m_bLastReached = bReached;
+    ++m_Stats.numSolves;
+    m_Stats.numIterations += numIterations;
+    m_Stats.numReached += bReached ? 1 : 0;
+
+    if (m_bEnabled)
+    {
+        m_LastSolution = chain;
+        m_LastTarget = goal;
+    }
+    
+} // RecordSolve
+
+// ---------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,326 @@
+﻿#include "IK/JacobianIKSolver.h"
+
+#include <cmath>
+
+#include "Core/BasicUtils.h"
+#include "Core/Transform.h"
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+namespace JacobianIKHelpers
+{
+    // Symmetric 3x3 matrix, only the upper triangle is stored
+    struct SymMat3
+    {
+        float xx = 0.f, xy = 0.f, xz = 0.f;
+        float yy = 0.f, yz = 0.f;
+        float zz = 0.f;
+    };
+
+    // Adds weight * [r]x * [r]x^T = weight * (|r|^2 * I - r * r^T), the block of J * W * J^T of a joint with
+    // effector offset r, its columns for the three world axes being axis x r
+    inline void AddJointBlock(SymMat3& m, const Vec3& r, float weight)
+    {
+        const float rSq = r.LenSq();
+        m.xx += weight * (rSq - r.x * r.x);
+        m.xy -= weight * r.x * r.y;
+        m.xz -= weight * r.x * r.z;
+        m.yy += weight * (rSq - r.y * r.y);
+        m.yz -= weight * r.y * r.z;
+        m.zz += weight * (rSq - r.z * r.z);
+    }
+
+    // Solves m * out = b through the adjugate, false if m is singular
+    inline bool SolveSymmetric(const SymMat3& m, const Vec3& b, Vec3& out)
+    {
+        const float c00 = m.yy * m.zz - m.yz * m.yz;
+        const float c01 = m.xz * m.yz - m.xy * m.zz;
+        const float c02 = m.xy * m.yz - m.xz * m.yy;
+        const float c11 = m.xx * m.zz - m.xz * m.xz;
+        const float c12 = m.xy * m.xz - m.xx * m.yz;
+        const float c22 = m.xx * m.yy - m.xy * m.xy;
+
+        // Relative to trace^3 since det grows with length^6, an absolute bound would reject small chains
+        const float det = m.xx * c00 + m.xy * c01 + m.xz * c02;
+        const float trace = m.xx + m.yy + m.zz;
+        if (!(det > EPS * trace * trace * trace))
+        {
+            return false;
+        }
+
+        const float invDet = 1.f / det;
+        out = Vec3(c00 * b.x + c01 * b.y + c02 * b.z,
+                   c01 * b.x + c11 * b.y + c12 * b.z,
+                   c02 * b.x + c12 * b.y + c22 * b.z) * invDet;
+        return true;
+    }
+    
+} // JacobianIKHelpers
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+JacobianIKSolver::JacobianIKSolver()
+{
+    
+} // JacobianIKSolver
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+unsigned JacobianIKSolver::GetSize() const
+{
+    return m_IKChain.size();
+    
+} // GetSize
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+unsigned JacobianIKSolver::GetNumSteps() const
+{
+    return m_NumSteps;
+    
+} // GetNumSteps
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+float JacobianIKSolver::GetThreshold() const
+{
+    return m_Threshold;
+    
+} // GetThreshold
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+float JacobianIKSolver::GetDamping() const
+{
+    return m_Damping;
+    
+} // GetDamping
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+float JacobianIKSolver::GetJointWeight(unsigned idx) const
+{
+    return m_Weights[idx];
+    
+} // GetJointWeight
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void JacobianIKSolver::Resize(unsigned newSize)
+{
+    m_IKChain.resize(newSize);
+    m_WorldChain.resize(newSize);
+    m_Constraints.resize(newSize);
+    m_Weights.resize(newSize, 1.f);
+    
+} // Resize
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void JacobianIKSolver::SetNumSteps(unsigned numSteps)
+{
+    m_NumSteps = numSteps;
+    
+} // SetNumSteps
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void JacobianIKSolver::SetThreshold(float threshold)
+{
+    m_Threshold = threshold;
+    
+} // SetThreshold
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void JacobianIKSolver::SetDamping(float damping)
+{
+    m_Damping = damping;
+    
+} // SetDamping
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void JacobianIKSolver::SetJointWeight(unsigned idx, float weight)
+{
+    m_Weights[idx] = weight;
+    
+} // SetJointWeight
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void JacobianIKSolver::SetConstraint(unsigned idx, const IKConstraint& constraint)
+{
+    m_Constraints[idx] = constraint;
+    
+} // SetConstraint
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+const IKConstraint& JacobianIKSolver::GetConstraint(unsigned idx) const
+{
+    return m_Constraints[idx];
+    
+} // GetConstraint
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+unsigned JacobianIKSolver::GetLastNumIterations() const
+{
+    return m_LastNumIterations;
+    
+} // GetLastNumIterations
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+const IKSolverStats& JacobianIKSolver::GetStats() const
+{
+    return m_Stats;
+    
+} // GetStats
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void JacobianIKSolver::ResetStats()
+{
+    m_Stats = {};
+    
+} // ResetStats
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+const Transform& JacobianIKSolver::operator[](unsigned idx) const
+{
+    return m_IKChain[idx];
+    
+} // operator[]
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+Transform& JacobianIKSolver::operator[](unsigned idx)
+{
+    return m_IKChain[idx];
+    
+} // operator[]
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+Transform JacobianIKSolver::GetGlobalTransform(unsigned idx) const
+{
+    Transform worldTransform = m_IKChain[idx];
+    for (int i = static_cast<int>(idx - 1); i >= 0; --i)
+    {
+        worldTransform = m_IKChain[i].Combine(worldTransform);
+    }
+    return worldTransform;
+    
+} // GetGlobalTransform
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+bool JacobianIKSolver::Solve(const Transform& target)
+{
+    if (m_IKChain.size() < 2)
+    {
+        return false;
+    }
+
+    const unsigned int size = GetSize();
+    const unsigned int lastIdx = size - 1;
+    const float thresholdSq = m_Threshold * m_Threshold;
+    const Vec3& goal = target.position;
+
+    UpdateWorldChain();
+
+    float chainLength = 0.f;
+    for (unsigned int i = 1; i < size; ++i)
+    {
+        chainLength += (m_WorldChain[i].position - m_WorldChain[i - 1].position).Len();
+    }
+
+    // Damping and the longest step both scale with the chain so the solver behaves the same at any size
+    static constexpr float MAX_STEP_RATIO = .25f;
+    const float dampingSq = m_Damping * chainLength * m_Damping * chainLength;
+    const float maxStep = MAX_STEP_RATIO * chainLength;
+
+    unsigned int numIterations = 0;
+    bool bReached = (goal - m_WorldChain[lastIdx].position).LenSq() < thresholdSq;
+    while (!bReached && numIterations < m_NumSteps)
+    {
+        const Vec3 effectorPos = m_WorldChain[lastIdx].position;
+        Vec3 error = goal - effectorPos;
+        const float errorLenSq = error.LenSq();
+        if (errorLenSq > maxStep * maxStep)
+        {
+            error = error * (maxStep / sqrtf(errorLenSq));
+        }
+
+        // (J * W * J^T + damping^2 * I) * y = error
+        JacobianIKHelpers::SymMat3 jwjt;
+        for (unsigned int j = 0; j < lastIdx; ++j)
+        {
+            JacobianIKHelpers::AddJointBlock(jwjt, effectorPos - m_WorldChain[j].position, m_Weights[j]);
+        }
+        jwjt.xx += dampingSq;
+        jwjt.yy += dampingSq;
+        jwjt.zz += dampingSq;
+
+        Vec3 y;
+        if (!JacobianIKHelpers::SolveSymmetric(jwjt, error, y))
+        {
+            break;
+        }
+
+        // Each joint turns by W * J^T * y = weight * (r x y) in world space, applied on top of its old parent so
+        // the rotations of the joints before it still carry it along
+        for (unsigned int j = 0; j < lastIdx; ++j)
+        {
+            const Vec3 axis = (effectorPos - m_WorldChain[j].position) ^ y;
+            const float axisLen = sqrtf(axis.LenSq());
+            const float angle = m_Weights[j] * axisLen;
+            if (angle < EPS)
+            {
+                continue;
+            }
+
+            // Built by hand, near the goal the axis is too short for Vec3::Normalized to touch it
+            const float halfAngle = angle * .5f;
+            const Quat worldDelta = {axis * (sinf(halfAngle) / axisLen), cosf(halfAngle)};
+            if (j == 0)
+            {
+                m_IKChain[j].rotation = m_Constraints[j].Apply(m_IKChain[j].rotation * worldDelta);
+                continue;
+            }
+
+            const Quat& parentRotation = m_WorldChain[j - 1].rotation;
+            const Quat localDelta = parentRotation * worldDelta * parentRotation.Inverse();
+            m_IKChain[j].rotation = m_Constraints[j].Apply(m_IKChain[j].rotation * localDelta);
+        }
+
+        UpdateWorldChain();
+        ++numIterations;
+        bReached = (goal - m_WorldChain[lastIdx].position).LenSq() < thresholdSq;
+    }
+
+    m_LastNumIterations = numIterations;
+    ++m_Stats.numSolves;
+    m_Stats.numIterations += numIterations;
+    m_Stats.numReached += bReached ? 1 : 0;
+    return bReached;
+    
+} // Solve
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void JacobianIKSolver::UpdateWorldChain()
+{
+    const unsigned int size = GetSize();
+    m_WorldChain[0] = m_IKChain[0];
+    for (unsigned int k = 1; k < size; ++k)
+    {
+        m_WorldChain[k] = m_WorldChain[k - 1].Combine(m_IKChain[k]);
+    }
+    
+} // UpdateWorldChain
+
+// ---------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,461 @@
+﻿#include "IK/TwoBoneIKBatch.h"
+
+#include <cmath>
+#include <xmmintrin.h>
+
+#include "Core/BasicUtils.h"
+#include "Core/Transform.h"
+#include "SkeletalMesh/Pose.h"
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+namespace TwoBoneIKBatchHelpers
+{
+    template <typename T>
+    inline void PushBack(T& soa, const Vec3& v)
+    {
+        soa.x.push_back(v.x);
+        soa.y.push_back(v.y);
+        soa.z.push_back(v.z);
+    }
+
+    template <typename T>
+    inline void Reserve(T& soa, unsigned int size)
+    {
+        soa.x.reserve(size);
+        soa.y.reserve(size);
+        soa.z.reserve(size);
+    }
+
+    template <typename T>
+    inline void Clear(T& soa)
+    {
+        soa.x.clear();
+        soa.y.clear();
+        soa.z.clear();
+    }
+
+    inline void Resize(std::vector<float>& x, std::vector<float>& y, std::vector<float>& z, std::vector<float>& w,
+        unsigned int size)
+    {
+        x.resize(size);
+        y.resize(size);
+        z.resize(size);
+        w.resize(size);
+    }
+
+    // Four chains per lane, masks are all ones or all zeros per lane so the branches become selects
+    struct Float4
+    {
+        __m128 v;
+
+        Float4(__m128 in) : v(in) {}
+        Float4(float f) : v(_mm_set1_ps(f)) {}
+    };
+
+    inline Float4 operator+(const Float4& a, const Float4& b) { return _mm_add_ps(a.v, b.v); }
+    inline Float4 operator-(const Float4& a, const Float4& b) { return _mm_sub_ps(a.v, b.v); }
+    inline Float4 operator*(const Float4& a, const Float4& b) { return _mm_mul_ps(a.v, b.v); }
+    inline Float4 operator/(const Float4& a, const Float4& b) { return _mm_div_ps(a.v, b.v); }
+    inline Float4 operator-(const Float4& a) { return _mm_sub_ps(_mm_setzero_ps(), a.v); }
+    inline Float4 operator<(const Float4& a, const Float4& b) { return _mm_cmplt_ps(a.v, b.v); }
+    inline Float4 operator>(const Float4& a, const Float4& b) { return _mm_cmpgt_ps(a.v, b.v); }
+    inline Float4 operator<=(const Float4& a, const Float4& b) { return _mm_cmple_ps(a.v, b.v); }
+    inline Float4 operator>=(const Float4& a, const Float4& b) { return _mm_cmpge_ps(a.v, b.v); }
+    inline Float4 operator&(const Float4& a, const Float4& b) { return _mm_and_ps(a.v, b.v); }
+
+    // Scalar versions for the chains left over after the last group of four
+    inline float Select(bool mask, float a, float b) { return mask ? a : b; }
+    inline float Sqrt(float a) { return sqrtf(a); }
+    inline float Min(float a, float b) { return a < b ? a : b; }
+    inline float Max(float a, float b) { return a > b ? a : b; }
+    inline float Abs(float a) { return std::abs(a); }
+
+    inline Float4 Select(const Float4& mask, const Float4& a, const Float4& b)
+    {
+        return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v));
+    }
+    inline Float4 Sqrt(const Float4& a) { return _mm_sqrt_ps(a.v); }
+    inline Float4 Min(const Float4& a, const Float4& b) { return _mm_min_ps(a.v, b.v); }
+    inline Float4 Max(const Float4& a, const Float4& b) { return _mm_max_ps(a.v, b.v); }
+    inline Float4 Abs(const Float4& a) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a.v); }
+
+    template <typename T>
+    inline T Clamp(const T& val, const T& lower, const T& upper)
+    {
+        return Max(lower, Min(val, upper));
+    }
+
+    template <typename T>
+    inline T Load(const float* in);
+
+    template <>
+    inline float Load<float>(const float* in)
+    {
+        return *in;
+    }
+
+    template <>
+    inline Float4 Load<Float4>(const float* in)
+    {
+        return _mm_loadu_ps(in);
+    }
+
+    inline void Store(float* out, float a)
+    {
+        *out = a;
+    }
+
+    inline void Store(float* out, const Float4& a)
+    {
+        _mm_storeu_ps(out, a.v);
+    }
+
+    inline void Store(unsigned char* out, bool mask)
+    {
+        *out = mask;
+    }
+
+    inline void Store(unsigned char* out, const Float4& mask)
+    {
+        const int bits = _mm_movemask_ps(mask.v);
+        for (unsigned int i = 0; i < 4; ++i)
+        {
+            out[i] = (bits >> i) & 1;
+        }
+    }
+
+    // v + 2w(q x v) + 2q x (q x v)
+    template <typename T>
+    inline void Rotate(const T& qx, const T& qy, const T& qz, const T& qw, T& x, T& y, T& z)
+    {
+        const T tx = 2.f * (qy * z - qz * y);
+        const T ty = 2.f * (qz * x - qx * z);
+        const T tz = 2.f * (qx * y - qy * x);
+        x = x + qw * tx + (qy * tz - qz * ty);
+        y = y + qw * ty + (qz * tx - qx * tz);
+        z = z + qw * tz + (qx * ty - qy * tx);
+    }
+
+    // Rotation around the axis by half the angle with that sine and cosine (scaled by the same length). Normalizing
+    // (axis * sin, length + cos) gives the half angle without any trigonometric call, an angle of pi is a half turn
+    template <typename T, typename MASK>
+    inline void HalfAngleRotation(const T& sinAngle, const T& cosAngle, const T& length, const T& ax, const T& ay,
+        const T& az, const MASK& bApply, T& qx, T& qy, T& qz, T& qw)
+    {
+        const MASK bHalfTurn = length + cosAngle < 1e-6f * length;
+        const T s = Select(bHalfTurn, T(1.f), sinAngle);
+        const T c = Select(bHalfTurn, T(0.f), length + cosAngle);
+        const T inv = Select(bApply, 1.f / Sqrt(s * s + c * c), T(0.f));
+        qx = ax * s * inv;
+        qy = ay * s * inv;
+        qz = az * s * inv;
+        qw = Select(bApply, c * inv, T(1.f));
+    }
+    
+} // TwoBoneIKBatchHelpers
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+TwoBoneIKBatch::TwoBoneIKBatch()
+{
+    
+} // TwoBoneIKBatch
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+unsigned TwoBoneIKBatch::GetSize() const
+{
+    return m_Chains.size();
+    
+} // GetSize
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+float TwoBoneIKBatch::GetThreshold() const
+{
+    return m_Threshold;
+    
+} // GetThreshold
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+bool TwoBoneIKBatch::IsReachable(unsigned idx) const
+{
+    return m_Reachable[idx] != 0;
+    
+} // IsReachable
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void TwoBoneIKBatch::SetThreshold(float threshold)
+{
+    m_Threshold = threshold;
+    
+} // SetThreshold
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void TwoBoneIKBatch::Reserve(unsigned numChains)
+{
+    m_Chains.reserve(numChains);
+    TwoBoneIKBatchHelpers::Reserve(m_Root, numChains);
+    TwoBoneIKBatchHelpers::Reserve(m_Middle, numChains);
+    TwoBoneIKBatchHelpers::Reserve(m_End, numChains);
+    TwoBoneIKBatchHelpers::Reserve(m_Target, numChains);
+    TwoBoneIKBatchHelpers::Reserve(m_BendDirection, numChains);
+    m_HasBendDirection.reserve(numChains);
+    
+} // Reserve
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void TwoBoneIKBatch::Clear()
+{
+    m_Chains.clear();
+    TwoBoneIKBatchHelpers::Clear(m_Root);
+    TwoBoneIKBatchHelpers::Clear(m_Middle);
+    TwoBoneIKBatchHelpers::Clear(m_End);
+    TwoBoneIKBatchHelpers::Clear(m_Target);
+    TwoBoneIKBatchHelpers::Clear(m_BendDirection);
+    m_HasBendDirection.clear();
+    
+} // Clear
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+unsigned TwoBoneIKBatch::AddChain(Pose& pose, const Transform& model, unsigned rootIdx, unsigned middleIdx,
+    unsigned endIdx, const Vec3& target)
+{
+    const unsigned int idx = AddChain(pose, model, rootIdx, middleIdx, endIdx, target, Vec3());
+    m_HasBendDirection[idx] = 0.f;
+    return idx;
+    
+} // AddChain
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+unsigned TwoBoneIKBatch::AddChain(Pose& pose, const Transform& model, unsigned rootIdx, unsigned middleIdx,
+    unsigned endIdx, const Vec3& target, const Vec3& bendDirection)
+{
+    // Only the parent needs a walk up the hierarchy, the chain itself is built from its locals
+    const int parentIdx = pose.GetParent(rootIdx);
+    const Transform parentWorld = parentIdx >= 0 ? model.Combine(pose.GetGlobalTransform(parentIdx)) : model;
+    const Transform rootWorld = parentWorld.Combine(pose.GetLocalTransform(rootIdx));
+    const Transform middleWorld = rootWorld.Combine(pose.GetLocalTransform(middleIdx));
+    const Transform endWorld = middleWorld.Combine(pose.GetLocalTransform(endIdx));
+
+    m_Chains.push_back({&pose, rootIdx, middleIdx, parentWorld.rotation, rootWorld.rotation});
+    TwoBoneIKBatchHelpers::PushBack(m_Root, rootWorld.position);
+    TwoBoneIKBatchHelpers::PushBack(m_Middle, middleWorld.position);
+    TwoBoneIKBatchHelpers::PushBack(m_End, endWorld.position);
+    TwoBoneIKBatchHelpers::PushBack(m_Target, target);
+    TwoBoneIKBatchHelpers::PushBack(m_BendDirection, bendDirection);
+    m_HasBendDirection.push_back(1.f);
+
+    return m_Chains.size() - 1;
+    
+} // AddChain
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void TwoBoneIKBatch::Solve()
+{
+    SolveChains();
+    WriteBack();
+    
+} // Solve
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void TwoBoneIKBatch::SolveChains()
+{
+    const unsigned int size = GetSize();
+    TwoBoneIKBatchHelpers::Resize(m_RootBend.x, m_RootBend.y, m_RootBend.z, m_RootBend.w, size);
+    TwoBoneIKBatchHelpers::Resize(m_MiddleBend.x, m_MiddleBend.y, m_MiddleBend.z, m_MiddleBend.w, size);
+    TwoBoneIKBatchHelpers::Resize(m_Swing.x, m_Swing.y, m_Swing.z, m_Swing.w, size);
+    TwoBoneIKBatchHelpers::Resize(m_Twist.x, m_Twist.y, m_Twist.z, m_Twist.w, size);
+    m_Reachable.resize(size);
+
+    // Four chains at a time with SSE, the rest one by one through the same code
+    unsigned int i = 0;
+    for (; i + 4 <= size; i += 4)
+    {
+        SolveLanes<TwoBoneIKBatchHelpers::Float4>(i);
+    }
+    for (; i < size; ++i)
+    {
+        SolveLanes<float>(i);
+    }
+    
+} // SolveChains
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+template <typename T>
+void TwoBoneIKBatch::SolveLanes(unsigned first)
+{
+    using namespace TwoBoneIKBatchHelpers;
+    using MASK = decltype(T(0.f) < T(0.f));
+
+    // Same closed form as TwoBoneIKSolver, each angle is kept as its sine and cosine so every step is arithmetic,
+    // a square root or a select
+    const T rootX = Load<T>(&m_Root.x[first]), rootY = Load<T>(&m_Root.y[first]), rootZ = Load<T>(&m_Root.z[first]);
+    const T middleX = Load<T>(&m_Middle.x[first]), middleY = Load<T>(&m_Middle.y[first]);
+    const T middleZ = Load<T>(&m_Middle.z[first]);
+    const T endX = Load<T>(&m_End.x[first]), endY = Load<T>(&m_End.y[first]), endZ = Load<T>(&m_End.z[first]);
+
+    // Root to end, root to middle, middle to end and root to target
+    const T ux = endX - rootX, uy = endY - rootY, uz = endZ - rootZ;
+    const T mx = middleX - rootX, my = middleY - rootY, mz = middleZ - rootZ;
+    const T ex = endX - middleX, ey = endY - middleY, ez = endZ - middleZ;
+    const T gx = Load<T>(&m_Target.x[first]) - rootX, gy = Load<T>(&m_Target.y[first]) - rootY;
+    const T gz = Load<T>(&m_Target.z[first]) - rootZ;
+
+    const T upperLength = Sqrt(mx * mx + my * my + mz * mz);
+    const T lowerLength = Sqrt(ex * ex + ey * ey + ez * ez);
+    const T endDistance = Sqrt(ux * ux + uy * uy + uz * uz);
+    const T targetDistance = Sqrt(gx * gx + gy * gy + gz * gz);
+
+    const T minReach = Abs(upperLength - lowerLength);
+    const T maxReach = upperLength + lowerLength;
+    Store(&m_Reachable[first], (targetDistance >= minReach - m_Threshold) & (targetDistance <= maxReach + m_Threshold));
+
+    // Degenerate chains are left as they are
+    const MASK bValid = (upperLength > EPS) & (lowerLength > EPS) & (endDistance > EPS) & (targetDistance > EPS);
+    const T upperInv = Select(bValid, 1.f / upperLength, T(0.f));
+    const T lowerInv = Select(bValid, 1.f / lowerLength, T(0.f));
+    const T endInv = Select(bValid, 1.f / endDistance, T(0.f));
+    const T targetInv = Select(bValid, 1.f / targetDistance, T(0.f));
+    const T reach = Clamp(targetDistance, minReach + 1e-4f * maxReach, maxReach * (1.f - 1e-4f));
+    const T reachInv = Select(bValid, 1.f / reach, T(0.f));
+
+    // Pole point, in front of the middle joint along the bend direction
+    const T hasPole = Load<T>(&m_HasBendDirection[first]);
+    const T px = mx + Load<T>(&m_BendDirection.x[first]) * upperLength * hasPole;
+    const T py = my + Load<T>(&m_BendDirection.y[first]) * upperLength * hasPole;
+    const T pz = mz + Load<T>(&m_BendDirection.z[first]) * upperLength * hasPole;
+
+    // Bend axis from the current plane, from the pole's plane or any plane when the chain is straight
+    T ax = uy * mz - uz * my, ay = uz * mx - ux * mz, az = ux * my - uy * mx;
+    const MASK bFlat = ax * ax + ay * ay + az * az < EPS * upperLength * lowerLength;
+    ax = Select(bFlat, uy * pz - uz * py, ax);
+    ay = Select(bFlat, uz * px - ux * pz, ay);
+    az = Select(bFlat, ux * py - uy * px, az);
+    const MASK bStraight = ax * ax + ay * ay + az * az < EPS;
+    const MASK bUseX = Abs(ux) < Abs(uy);
+    ax = Select(bStraight, Select(bUseX, T(0.f), -uz), ax);
+    ay = Select(bStraight, Select(bUseX, uz, T(0.f)), ay);
+    az = Select(bStraight, Select(bUseX, -uy, ux), az);
+
+    // A collapsed chain has no bend axis either, it gets identity corrections like any other degenerate chain
+    const T axisLengthSq = ax * ax + ay * ay + az * az;
+    const MASK bSolve = bValid & (axisLengthSq > EPS);
+    const T axisInv = Select(bSolve, 1.f / Sqrt(axisLengthSq), T(0.f));
+    ax = ax * axisInv;
+    ay = ay * axisInv;
+    az = az * axisInv;
+
+    // Root and middle angles from the law of cosines, both in [0, pi] so their sines are positive
+    const T upperSq = upperLength * upperLength;
+    const T lowerSq = lowerLength * lowerLength;
+    const T reachSq = reach * reach;
+    const T rootCos = Clamp((ux * mx + uy * my + uz * mz) * endInv * upperInv, T(-1.f), T(1.f));
+    const T middleCos = Clamp(-(mx * ex + my * ey + mz * ez) * upperInv * lowerInv, T(-1.f), T(1.f));
+    const T rootTargetCos = Clamp((upperSq + reachSq - lowerSq) * .5f * upperInv * reachInv, T(-1.f), T(1.f));
+    const T middleTargetCos = Clamp((upperSq + lowerSq - reachSq) * .5f * upperInv * lowerInv, T(-1.f), T(1.f));
+    const T rootSin = Sqrt(Max(1.f - rootCos * rootCos, T(0.f)));
+    const T middleSin = Sqrt(Max(1.f - middleCos * middleCos, T(0.f)));
+    const T rootTargetSin = Sqrt(Max(1.f - rootTargetCos * rootTargetCos, T(0.f)));
+    const T middleTargetSin = Sqrt(Max(1.f - middleTargetCos * middleTargetCos, T(0.f)));
+
+    // Both bends turn by the target angle minus the current one
+    T qx = 0.f, qy = 0.f, qz = 0.f, qw = 1.f;
+    HalfAngleRotation(rootTargetSin * rootCos - rootTargetCos * rootSin,
+        rootTargetCos * rootCos + rootTargetSin * rootSin, T(1.f), ax, ay, az, bSolve, qx, qy, qz, qw);
+    const T rootBendX = qx, rootBendY = qy, rootBendZ = qz, rootBendW = qw;
+    Store(&m_RootBend.x[first], qx);
+    Store(&m_RootBend.y[first], qy);
+    Store(&m_RootBend.z[first], qz);
+    Store(&m_RootBend.w[first], qw);
+
+    HalfAngleRotation(middleTargetSin * middleCos - middleTargetCos * middleSin,
+        middleTargetCos * middleCos + middleTargetSin * middleSin, T(1.f), ax, ay, az, bSolve, qx, qy, qz, qw);
+    Store(&m_MiddleBend.x[first], qx);
+    Store(&m_MiddleBend.y[first], qy);
+    Store(&m_MiddleBend.z[first], qz);
+    Store(&m_MiddleBend.w[first], qw);
+
+    // Swing from the end direction, which the bend keeps, to the target direction
+    const T nx = gx * targetInv, ny = gy * targetInv, nz = gz * targetInv;
+    const T dx = ux * endInv, dy = uy * endInv, dz = uz * endInv;
+    T sx = dy * nz - dz * ny, sy = dz * nx - dx * nz, sz = dx * ny - dy * nx;
+    T sw = 1.f + (dx * nx + dy * ny + dz * nz);
+
+    // Opposite directions, half turn around the bend axis which is perpendicular to both
+    const MASK bOpposite = sw < 1e-6f;
+    sx = Select(bOpposite, ax, sx);
+    sy = Select(bOpposite, ay, sy);
+    sz = Select(bOpposite, az, sz);
+    sw = Select(bOpposite, T(0.f), sw);
+    const T swingInv = Select(bSolve, 1.f / Sqrt(sx * sx + sy * sy + sz * sz + sw * sw), T(0.f));
+    sx = sx * swingInv;
+    sy = sy * swingInv;
+    sz = sz * swingInv;
+    sw = Select(bSolve, sw * swingInv, T(1.f));
+    Store(&m_Swing.x[first], sx);
+    Store(&m_Swing.y[first], sy);
+    Store(&m_Swing.z[first], sz);
+    Store(&m_Swing.w[first], sw);
+
+    // Twist around the target direction until the bent and swung middle joint faces the pole
+    T bx = mx, by = my, bz = mz;
+    Rotate(rootBendX, rootBendY, rootBendZ, rootBendW, bx, by, bz);
+    Rotate(sx, sy, sz, sw, bx, by, bz);
+    const T bDot = bx * nx + by * ny + bz * nz;
+    const T pDot = px * nx + py * ny + pz * nz;
+    bx = bx - nx * bDot;
+    by = by - ny * bDot;
+    bz = bz - nz * bDot;
+    const T ppx = px - nx * pDot, ppy = py - ny * pDot, ppz = pz - nz * pDot;
+    const T bLengthSq = bx * bx + by * by + bz * bz;
+    const T ppLengthSq = ppx * ppx + ppy * ppy + ppz * ppz;
+    const T twistSin = (by * ppz - bz * ppy) * nx + (bz * ppx - bx * ppz) * ny + (bx * ppy - by * ppx) * nz;
+    const T twistCos = bx * ppx + by * ppy + bz * ppz;
+    const MASK bTwist = bSolve & (hasPole > 0.f) & (bLengthSq > EPS) & (ppLengthSq > EPS);
+    HalfAngleRotation(twistSin, twistCos, Sqrt(bLengthSq * ppLengthSq), nx, ny, nz, bTwist, qx, qy, qz, qw);
+    Store(&m_Twist.x[first], qx);
+    Store(&m_Twist.y[first], qy);
+    Store(&m_Twist.z[first], qz);
+    Store(&m_Twist.w[first], qw);
+    
+} // SolveLanes
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void TwoBoneIKBatch::WriteBack()
+{
+    const unsigned int size = GetSize();
+    for (unsigned int i = 0; i < size; ++i)
+    {
+        const ChainInfo& chain = m_Chains[i];
+        const Quat rootBend(m_RootBend.x[i], m_RootBend.y[i], m_RootBend.z[i], m_RootBend.w[i]);
+        const Quat middleBend(m_MiddleBend.x[i], m_MiddleBend.y[i], m_MiddleBend.z[i], m_MiddleBend.w[i]);
+        const Quat swing(m_Swing.x[i], m_Swing.y[i], m_Swing.z[i], m_Swing.w[i]);
+        const Quat twist(m_Twist.x[i], m_Twist.y[i], m_Twist.z[i], m_Twist.w[i]);
+
+        // World corrections back to locals: the root is corrected under its parent, the middle under the old root.
+        // Both bends share the axis so the root bend cancels out for the middle joint
+        Transform root = chain.pose->GetLocalTransform(chain.rootIdx);
+        root.rotation = root.rotation * chain.parentRotation * (rootBend * swing * twist) *
+            chain.parentRotation.Inverse();
+        chain.pose->SetLocalTransform(chain.rootIdx, root);
+
+        Transform middle = chain.pose->GetLocalTransform(chain.middleIdx);
+        middle.rotation = middle.rotation * chain.rootRotation * middleBend * chain.rootRotation.Inverse();
+        chain.pose->SetLocalTransform(chain.middleIdx, middle);
+    }
+    
+} // WriteBack
+
+// ---------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,224 @@
+﻿#include "IK/TwoBoneIKSolver.h"
+
+#include <cmath>
+
+#include "Core/BasicUtils.h"
+#include "Core/Quat.h"
+#include "Core/Transform.h"
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+namespace TwoBoneIKHelpers
+{
+    inline float AngleBetween(const Vec3& u, const Vec3& v)
+    {
+        return acosf(BasicUtils::Clamp(u.Normalized() | v.Normalized(), -1.f, 1.f));
+    }
+
+    // Interior angle opposite to the side "opposite" in a triangle with the other two sides
+    inline float LawOfCosines(float side0, float side1, float opposite)
+    {
+        const float cosAngle = (side0 * side0 + side1 * side1 - opposite * opposite) / (2.f * side0 * side1);
+        return acosf(BasicUtils::Clamp(cosAngle, -1.f, 1.f));
+    }
+
+    // Any direction perpendicular to v
+    inline Vec3 Perpendicular(const Vec3& v)
+    {
+        const Vec3 axis = std::abs(v.x) < std::abs(v.y) ? Vec3(1.f, 0.f, 0.f) : Vec3(0.f, 1.f, 0.f);
+        return v ^ axis;
+    }
+    
+} // TwoBoneIKHelpers
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+constexpr unsigned int TwoBoneIKSolver::SIZE;
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+TwoBoneIKSolver::TwoBoneIKSolver() : m_IKChain(SIZE)
+{
+    
+} // TwoBoneIKSolver
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+unsigned TwoBoneIKSolver::GetSize() const
+{
+    return SIZE;
+    
+} // GetSize
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+float TwoBoneIKSolver::GetThreshold() const
+{
+    return m_Threshold;
+    
+} // GetThreshold
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+const Transform& TwoBoneIKSolver::GetLocalTransform(unsigned idx) const
+{
+    return m_IKChain[idx];
+    
+} // GetLocalTransform
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+Transform& TwoBoneIKSolver::GetLocalTransform(unsigned idx)
+{
+    return m_IKChain[idx];
+    
+} // GetLocalTransform
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+const Vec3& TwoBoneIKSolver::GetPoleVector() const
+{
+    return m_PoleVector;
+    
+} // GetPoleVector
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+bool TwoBoneIKSolver::HasPoleVector() const
+{
+    return m_bHasPole;
+    
+} // HasPoleVector
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+const Transform& TwoBoneIKSolver::operator[](unsigned idx) const
+{
+    return m_IKChain[idx];
+    
+} // operator[]
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+Transform& TwoBoneIKSolver::operator[](unsigned idx)
+{
+    return m_IKChain[idx];
+    
+} // operator[]
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void TwoBoneIKSolver::SetThreshold(float threshold)
+{
+    m_Threshold = threshold;
+    
+} // SetThreshold
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void TwoBoneIKSolver::SetLocalTransform(unsigned idx, const Transform& t)
+{
+    m_IKChain[idx] = t;
+    
+} // SetLocalTransform
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void TwoBoneIKSolver::SetPoleVector(const Vec3& pole)
+{
+    m_PoleVector = pole;
+    m_bHasPole = true;
+    
+} // SetPoleVector
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void TwoBoneIKSolver::ClearPoleVector()
+{
+    m_bHasPole = false;
+    
+} // ClearPoleVector
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+Transform TwoBoneIKSolver::GetGlobalTransform(unsigned idx) const
+{
+    Transform world = m_IKChain[idx];
+    for (int i = static_cast<int>(idx) - 1; i >= 0; --i)
+    {
+        world = m_IKChain[i].Combine(world);
+    }
+
+    return world;
+    
+} // GetGlobalTransform
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+bool TwoBoneIKSolver::Solve(const Transform& target)
+{
+    Transform& root = m_IKChain[0];
+    Transform& middle = m_IKChain[1];
+    const Vec3 rootPos = root.position;
+    const Vec3 middlePos = root.Combine(middle).position;
+    const Vec3 endPos = GetGlobalTransform(2).position;
+    const Vec3 toTarget = target.position - rootPos;
+
+    const float upperLength = (middlePos - rootPos).Len();
+    const float lowerLength = (endPos - middlePos).Len();
+    const float targetDistance = toTarget.Len();
+    if (BasicUtils::IsZero(upperLength) || BasicUtils::IsZero(lowerLength) || BasicUtils::IsZero(targetDistance))
+    {
+        return false;
+    }
+
+    // Keep the triangle from fully collapsing or stretching so the bend plane is never lost
+    const float minReach = std::abs(upperLength - lowerLength);
+    const float maxReach = upperLength + lowerLength;
+    const float reach = BasicUtils::Clamp(targetDistance, minReach + 1e-4f * maxReach, maxReach * (1.f - 1e-4f));
+
+    // Bend around the normal of the current plane; a straight chain takes the pole's plane or any plane
+    Vec3 bendAxis = (endPos - rootPos) ^ (middlePos - rootPos);
+    if (bendAxis.LenSq() < EPS * upperLength * lowerLength)
+    {
+        bendAxis = m_bHasPole ? (endPos - rootPos) ^ (m_PoleVector - rootPos) : Vec3();
+        if (bendAxis.LenSq() < EPS)
+        {
+            bendAxis = TwoBoneIKHelpers::Perpendicular(endPos - rootPos);
+        }
+    }
+
+    // Open or close the root and middle angles so the end lands at the reach distance, direction is kept
+    const float rootAngle = TwoBoneIKHelpers::AngleBetween(endPos - rootPos, middlePos - rootPos);
+    const float middleAngle = TwoBoneIKHelpers::AngleBetween(rootPos - middlePos, endPos - middlePos);
+    const float rootAngleTarget = TwoBoneIKHelpers::LawOfCosines(upperLength, reach, lowerLength);
+    const float middleAngleTarget = TwoBoneIKHelpers::LawOfCosines(upperLength, lowerLength, reach);
+
+    root.rotation = root.rotation * Quat::CreateFromAxis(rootAngleTarget - rootAngle, bendAxis);
+    const Quat middleWorldRotation = middle.rotation * root.rotation;
+    middle.rotation = middleWorldRotation * Quat::CreateFromAxis(middleAngleTarget - middleAngle, bendAxis) *
+        root.rotation.Inverse();
+
+    // Swing the whole chain to the target
+    root.rotation = root.rotation * Quat::FromTo(GetGlobalTransform(2).position - rootPos, toTarget);
+
+    // Twist around the root-target line until the middle joint faces the pole
+    if (m_bHasPole)
+    {
+        const Vec3 twistAxis = toTarget / targetDistance;
+        Vec3 toMiddle = root.Combine(middle).position - rootPos;
+        Vec3 toPole = m_PoleVector - rootPos;
+        toMiddle -= twistAxis * (toMiddle | twistAxis);
+        toPole -= twistAxis * (toPole | twistAxis);
+        if (!toMiddle.IsZeroVec() && !toPole.IsZeroVec())
+        {
+            const float twist = atan2f((toMiddle ^ toPole) | twistAxis, toMiddle | toPole);
+            root.rotation = root.rotation * Quat::CreateFromAxis(twist, twistAxis);
+        }
+    }
+
+    return targetDistance >= minReach - m_Threshold && targetDistance <= maxReach + m_Threshold;
+    
+} // Solve
+
+// ---------------------------------------------------------------------------------------------------------------------
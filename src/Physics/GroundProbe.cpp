@@ -0,0 +1,317 @@
+﻿#include "Physics/GroundProbe.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "Core/BasicUtils.h"
+#include "Physics/PhysicsLibrary.h"
+#include "SkeletalMesh/TriangleMesh.h"
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+constexpr unsigned int GroundProbe::MAX_CELLS;
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+GroundProbe::GroundProbe(float cellSize)
+{
+    SetCellSize(cellSize);
+    
+} // GroundProbe
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void GroundProbe::SetCellSize(float cellSize)
+{
+    static constexpr float MIN_CELL_SIZE = 0.001f;
+    m_CellSize = std::max(cellSize, MIN_CELL_SIZE);
+    m_InvCellSize = 1.f / m_CellSize;
+    
+} // SetCellSize
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void GroundProbe::Build(const std::vector<TriangleMesh>& triangles)
+{
+    m_Triangles = triangles;
+    m_CellStarts.clear();
+    m_CellTriangles.clear();
+    m_NumCellsX = 0;
+    m_NumCellsZ = 0;
+
+    if (m_Triangles.empty())
+    {
+        return;
+    }
+
+    float maxX = std::numeric_limits<float>::lowest();
+    float maxZ = std::numeric_limits<float>::lowest();
+    m_MinX = std::numeric_limits<float>::max();
+    m_MinZ = std::numeric_limits<float>::max();
+    for (const TriangleMesh& triangle : m_Triangles)
+    {
+        m_MinX = std::min({m_MinX, triangle.v0.x, triangle.v1.x, triangle.v2.x});
+        m_MinZ = std::min({m_MinZ, triangle.v0.z, triangle.v1.z, triangle.v2.z});
+        maxX = std::max({maxX, triangle.v0.x, triangle.v1.x, triangle.v2.x});
+        maxZ = std::max({maxZ, triangle.v0.z, triangle.v1.z, triangle.v2.z});
+    }
+
+    // Grow the cells on huge levels instead of allocating an unbounded grid
+    auto GetNumCells = [&]()
+    {
+        return (static_cast<double>((maxX - m_MinX) * m_InvCellSize) + 1.) *
+            (static_cast<double>((maxZ - m_MinZ) * m_InvCellSize) + 1.);
+    };
+    while (GetNumCells() > MAX_CELLS)
+    {
+        SetCellSize(m_CellSize * 2.f);
+    }
+
+    m_NumCellsX = GetCellX(maxX) + 1;
+    m_NumCellsZ = GetCellZ(maxZ) + 1;
+    const unsigned int numCells = m_NumCellsX * m_NumCellsZ;
+
+    // Every triangle goes to all the cells its XZ bounds overlap, counted first so the buckets are one array
+    auto VisitCells = [&](const TriangleMesh& triangle, auto visitor)
+    {
+        const int minCellX = GetCellX(std::min({triangle.v0.x, triangle.v1.x, triangle.v2.x}));
+        const int minCellZ = GetCellZ(std::min({triangle.v0.z, triangle.v1.z, triangle.v2.z}));
+        const int maxCellX = GetCellX(std::max({triangle.v0.x, triangle.v1.x, triangle.v2.x}));
+        const int maxCellZ = GetCellZ(std::max({triangle.v0.z, triangle.v1.z, triangle.v2.z}));
+        for (int z = minCellZ; z <= maxCellZ; ++z)
+        {
+            for (int x = minCellX; x <= maxCellX; ++x)
+            {
+                visitor(z * m_NumCellsX + x);
+            }
+        }
+    };
+
+    m_CellStarts.assign(numCells + 1, 0);
+    for (const TriangleMesh& triangle : m_Triangles)
+    {
+        VisitCells(triangle, [this](unsigned int cell) { ++m_CellStarts[cell + 1]; });
+    }
+
+    for (unsigned int i = 0; i < numCells; ++i)
+    {
+        m_CellStarts[i + 1] += m_CellStarts[i];
+    }
+
+    std::vector<unsigned int> cursors(m_CellStarts.begin(), m_CellStarts.end() - 1);
+    m_CellTriangles.resize(m_CellStarts[numCells]);
+    const unsigned int numTriangles = m_Triangles.size();
+    for (unsigned int i = 0; i < numTriangles; ++i)
+    {
+        VisitCells(m_Triangles[i], [&](unsigned int cell) { m_CellTriangles[cursors[cell]++] = i; });
+    }
+    
+} // Build
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+unsigned GroundProbe::AddRay(const Ray& ray, float maxDistance)
+{
+    m_Rays.push_back(ray);
+    m_MaxDistances.push_back(maxDistance);
+    return m_Rays.size() - 1;
+    
+} // AddRay
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void GroundProbe::ClearRays()
+{
+    m_Rays.clear();
+    m_MaxDistances.clear();
+    
+} // ClearRays
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void GroundProbe::Resolve()
+{
+    const unsigned int numRays = GetNumRays();
+    m_Hits.resize(numRays);
+    m_RayOrder.resize(numRays);
+    m_RayCells.resize(numRays);
+
+    for (unsigned int i = 0; i < numRays; ++i)
+    {
+        m_RayOrder[i] = i;
+        if (m_NumCellsX == 0)
+        {
+            m_RayCells[i] = 0;
+            continue;
+        }
+        
+        const int cellX = BasicUtils::Clamp(GetCellX(m_Rays[i].origin.x), 0, m_NumCellsX - 1);
+        const int cellZ = BasicUtils::Clamp(GetCellZ(m_Rays[i].origin.z), 0, m_NumCellsZ - 1);
+        m_RayCells[i] = cellZ * m_NumCellsX + cellX;
+    }
+
+    std::sort(m_RayOrder.begin(), m_RayOrder.end(), [this](unsigned int a, unsigned int b)
+    {
+        return m_RayCells[a] < m_RayCells[b];
+    });
+
+    m_LastNumTriangleTests = 0;
+    for (const unsigned int rayIdx : m_RayOrder)
+    {
+        Trace(m_Rays[rayIdx], m_MaxDistances[rayIdx], m_Hits[rayIdx], m_LastNumTriangleTests);
+    }
+    
+} // Resolve
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+const GroundProbeHit& GroundProbe::GetHit(unsigned rayIdx) const
+{
+    return m_Hits[rayIdx];
+    
+} // GetHit
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+bool GroundProbe::Raycast(const Ray& ray, GroundProbeHit& outHit, float maxDistance) const
+{
+    unsigned int numTests = 0;
+    return Trace(ray, maxDistance, outHit, numTests);
+    
+} // Raycast
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+int GroundProbe::GetCellX(float x) const
+{
+    return static_cast<int>(floorf((x - m_MinX) * m_InvCellSize));
+    
+} // GetCellX
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+int GroundProbe::GetCellZ(float z) const
+{
+    return static_cast<int>(floorf((z - m_MinZ) * m_InvCellSize));
+    
+} // GetCellZ
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+bool GroundProbe::Trace(const Ray& ray, float maxDistance, GroundProbeHit& outHit, unsigned& outNumTests) const
+{
+    outHit = {};
+    
+    const float dirLen = sqrtf(ray.direction.LenSq());
+    if (m_NumCellsX == 0 || dirLen < EPS)
+    {
+        return false;
+    }
+
+    // Distances are along the ray parameter from here, direction doesn't need to be normalized
+    static constexpr float INF = std::numeric_limits<float>::max();
+    float tEnter = 0.f;
+    float tExit = maxDistance < 0.f ? INF : maxDistance / dirLen;
+
+    // Clip the ray against the grid bounds on XZ
+    auto ClipAxis = [&](float origin, float dir, float minValue, float maxValue) -> bool
+    {
+        if (fabsf(dir) < EPS)
+        {
+            return origin >= minValue && origin <= maxValue;
+        }
+
+        float t0 = (minValue - origin) / dir;
+        float t1 = (maxValue - origin) / dir;
+        if (t0 > t1)
+        {
+            std::swap(t0, t1);
+        }
+
+        tEnter = std::max(tEnter, t0);
+        tExit = std::min(tExit, t1);
+        return tEnter <= tExit;
+    };
+
+    const float maxX = m_MinX + m_NumCellsX * m_CellSize;
+    const float maxZ = m_MinZ + m_NumCellsZ * m_CellSize;
+    if (!ClipAxis(ray.origin.x, ray.direction.x, m_MinX, maxX) ||
+        !ClipAxis(ray.origin.z, ray.direction.z, m_MinZ, maxZ))
+    {
+        return false;
+    }
+
+    // Walk the cells under the ray in order (2D DDA)
+    const Vec3 start = ray.origin + ray.direction * tEnter;
+    int cellX = BasicUtils::Clamp(GetCellX(start.x), 0, m_NumCellsX - 1);
+    int cellZ = BasicUtils::Clamp(GetCellZ(start.z), 0, m_NumCellsZ - 1);
+
+    const int stepX = ray.direction.x > 0.f ? 1 : -1;
+    const int stepZ = ray.direction.z > 0.f ? 1 : -1;
+    const bool bMovesX = fabsf(ray.direction.x) >= EPS;
+    const bool bMovesZ = fabsf(ray.direction.z) >= EPS;
+    const float tDeltaX = bMovesX ? m_CellSize / fabsf(ray.direction.x) : INF;
+    const float tDeltaZ = bMovesZ ? m_CellSize / fabsf(ray.direction.z) : INF;
+    float tNextX = bMovesX ? (m_MinX + (cellX + (stepX > 0 ? 1 : 0)) * m_CellSize - ray.origin.x) / ray.direction.x
+        : INF;
+    float tNextZ = bMovesZ ? (m_MinZ + (cellZ + (stepZ > 0 ? 1 : 0)) * m_CellSize - ray.origin.z) / ray.direction.z
+        : INF;
+
+    float bestT = tExit;
+    int bestTriangle = -1;
+    while (true)
+    {
+        const unsigned int cell = cellZ * m_NumCellsX + cellX;
+        const unsigned int cellEnd = m_CellStarts[cell + 1];
+        for (unsigned int i = m_CellStarts[cell]; i < cellEnd; ++i)
+        {
+            const unsigned int triangleIdx = m_CellTriangles[i];
+            float t;
+            ++outNumTests;
+            if (PhysicsLibrary::RaycastTriangle(ray, m_Triangles[triangleIdx], t) && t <= bestT)
+            {
+                bestT = t;
+                bestTriangle = static_cast<int>(triangleIdx);
+            }
+        }
+
+        // A hit beyond this cell could still lose against a triangle of the next cells
+        const float tCellExit = std::min(tNextX, tNextZ);
+        if ((bestTriangle >= 0 && bestT <= tCellExit) || tCellExit >= tExit)
+        {
+            break;
+        }
+
+        if (tNextX < tNextZ)
+        {
+            cellX += stepX;
+            tNextX += tDeltaX;
+        }
+        else
+        {
+            cellZ += stepZ;
+            tNextZ += tDeltaZ;
+        }
+
+        if (cellX < 0 || cellX >= m_NumCellsX || cellZ < 0 || cellZ >= m_NumCellsZ)
+        {
+            break;
+        }
+    }
+
+    if (bestTriangle < 0)
+    {
+        return false;
+    }
+
+    const Vec3& normal = m_Triangles[bestTriangle].normal;
+    outHit.point = ray.origin + ray.direction * bestT;
+    outHit.normal = (normal | ray.direction) > 0.f ? -normal : normal;
+    outHit.distance = bestT * dirLen;
+    outHit.bHit = true;
+    return true;
+    
+} // Trace
+
+// ---------------------------------------------------------------------------------------------------------------------
@@ -7,6 +7,21 @@
 // ---------------------------------------------------------------------------------------------------------------------
 
 bool PhysicsLibrary::RaycastTriangle(const Ray& ray, const TriangleMesh& triangle, Vec3& hitPoint)
+{
+    float t;
+    if (!RaycastTriangle(ray, triangle, t))
+    {
+        return false;
+    }
+    
+    hitPoint = ray.origin + ray.direction * t;
+    return true;
+    
+} // RaycastTriangle
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+bool PhysicsLibrary::RaycastTriangle(const Ray& ray, const TriangleMesh& triangle, float& outT)
 {
     static constexpr float EPSILON = 0.0000001f;
     
@@ -42,7 +57,7 @@ bool PhysicsLibrary::RaycastTriangle(const Ray& ray, const TriangleMesh& triangl
         return false;
     }
     
-    hitPoint = ray.origin + ray.direction * t;
+    outT = t;
     return true;
     
 } // RaycastTriangle
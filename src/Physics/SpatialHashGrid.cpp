@@ -0,0 +1,275 @@
+﻿#include "Physics/SpatialHashGrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+constexpr unsigned int SpatialHashGrid::INVALID_SLOT;
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+SpatialHashGrid::SpatialHashGrid(float cellSize)
+{
+    SetCellSize(cellSize);
+    
+} // SpatialHashGrid
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+bool SpatialHashGrid::Contains(unsigned id) const
+{
+    return id < m_Slots.size() && m_Slots[id] != INVALID_SLOT;
+    
+} // Contains
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void SpatialHashGrid::SetCellSize(float cellSize)
+{
+    static constexpr float MIN_CELL_SIZE = 0.001f;
+    m_CellSize = std::max(cellSize, MIN_CELL_SIZE);
+    m_InvCellSize = 1.f / m_CellSize;
+
+    if (m_NumPoints == 0)
+    {
+        return;
+    }
+
+    m_Cells.clear();
+    const unsigned int size = m_Slots.size();
+    for (unsigned int i = 0; i < size; ++i)
+    {
+        if (m_Slots[i] != INVALID_SLOT)
+        {
+            AddToCell(i, GetCellKey(m_Positions[i]));
+        }
+    }
+    
+} // SetCellSize
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void SpatialHashGrid::Clear()
+{
+    m_Cells.clear();
+    m_Positions.clear();
+    m_Keys.clear();
+    m_Slots.clear();
+    m_NumPoints = 0;
+    
+} // Clear
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void SpatialHashGrid::Insert(unsigned id, const Vec3& position)
+{
+    if (id >= m_Slots.size())
+    {
+        m_Positions.resize(id + 1);
+        m_Keys.resize(id + 1);
+        m_Slots.resize(id + 1, INVALID_SLOT);
+    }
+
+    if (m_Slots[id] != INVALID_SLOT)
+    {
+        Move(id, position);
+        return;
+    }
+
+    m_Positions[id] = position;
+    AddToCell(id, GetCellKey(position));
+    ++m_NumPoints;
+    
+} // Insert
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void SpatialHashGrid::Remove(unsigned id)
+{
+    if (!Contains(id))
+    {
+        return;
+    }
+
+    RemoveFromCell(id);
+    m_Slots[id] = INVALID_SLOT;
+    --m_NumPoints;
+    
+} // Remove
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void SpatialHashGrid::Move(unsigned id, const Vec3& position)
+{
+    if (!Contains(id))
+    {
+        Insert(id, position);
+        return;
+    }
+
+    m_Positions[id] = position;
+    
+    // Most moves stay inside the same cell
+    const uint64_t key = GetCellKey(position);
+    if (key == m_Keys[id])
+    {
+        return;
+    }
+
+    RemoveFromCell(id);
+    AddToCell(id, key);
+    
+} // Move
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void SpatialHashGrid::Query(const Vec3& center, float radius, std::vector<unsigned>& outIds) const
+{
+    outIds.clear();
+    VisitSphere(center, radius, [&outIds](unsigned int id, float)
+    {
+        outIds.push_back(id);
+        return true;
+    });
+    
+} // Query
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+bool SpatialHashGrid::AnyWithinRadius(const Vec3& center, float radius) const
+{
+    bool bFound = false;
+    VisitSphere(center, radius, [&bFound](unsigned int, float)
+    {
+        bFound = true;
+        return false;
+    });
+
+    return bFound;
+    
+} // AnyWithinRadius
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+int SpatialHashGrid::GetCellCoord(float value) const
+{
+    return static_cast<int>(floorf(value * m_InvCellSize));
+    
+} // GetCellCoord
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+uint64_t SpatialHashGrid::GetCellKey(int x, int y, int z)
+{
+    // 21 bits per axis, coordinates wrap around far outside any crowd
+    static constexpr uint64_t AXIS_MASK = (1ull << 21) - 1;
+    return ((static_cast<uint64_t>(x) & AXIS_MASK) << 42) | ((static_cast<uint64_t>(y) & AXIS_MASK) << 21) |
+        (static_cast<uint64_t>(z) & AXIS_MASK);
+    
+} // GetCellKey
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+uint64_t SpatialHashGrid::GetCellKey(const Vec3& position) const
+{
+    return GetCellKey(GetCellCoord(position.x), GetCellCoord(position.y), GetCellCoord(position.z));
+    
+} // GetCellKey
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void SpatialHashGrid::AddToCell(unsigned id, uint64_t key)
+{
+    std::vector<unsigned int>& cell = m_Cells[key];
+    m_Keys[id] = key;
+    m_Slots[id] = cell.size();
+    cell.push_back(id);
+    
+} // AddToCell
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void SpatialHashGrid::RemoveFromCell(unsigned id)
+{
+    const auto cellIt = m_Cells.find(m_Keys[id]);
+    std::vector<unsigned int>& cell = cellIt->second;
+
+    // Swap with the last one so removal is O(1)
+    const unsigned int slot = m_Slots[id];
+    const unsigned int lastId = cell.back();
+    cell[slot] = lastId;
+    m_Slots[lastId] = slot;
+    cell.pop_back();
+
+    if (cell.empty())
+    {
+        m_Cells.erase(cellIt);
+    }
+    
+} // RemoveFromCell
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+template <typename VISITOR>
+void SpatialHashGrid::VisitSphere(const Vec3& center, float radius, VISITOR visitor) const
+{
+    if (m_NumPoints == 0)
+    {
+        return;
+    }
+    
+    const float radiusSq = radius * radius;
+    const int minX = GetCellCoord(center.x - radius);
+    const int minY = GetCellCoord(center.y - radius);
+    const int minZ = GetCellCoord(center.z - radius);
+    const int maxX = GetCellCoord(center.x + radius);
+    const int maxY = GetCellCoord(center.y + radius);
+    const int maxZ = GetCellCoord(center.z + radius);
+
+    // Large radii (e.g. culling) would look up far more cells than there are points, scan the occupied ones instead
+    const uint64_t numBoxCells = static_cast<uint64_t>(maxX - minX + 1) * static_cast<uint64_t>(maxY - minY + 1) *
+        static_cast<uint64_t>(maxZ - minZ + 1);
+    if (numBoxCells > m_NumPoints)
+    {
+        for (const auto& cell : m_Cells)
+        {
+            for (const unsigned int id : cell.second)
+            {
+                const float distSq = (m_Positions[id] - center).LenSq();
+                if (distSq < radiusSq && !visitor(id, distSq))
+                {
+                    return;
+                }
+            }
+        }
+        return;
+    }
+
+    for (int x = minX; x <= maxX; ++x)
+    {
+        for (int y = minY; y <= maxY; ++y)
+        {
+            for (int z = minZ; z <= maxZ; ++z)
+            {
+                const auto cellIt = m_Cells.find(GetCellKey(x, y, z));
+                if (cellIt == m_Cells.end())
+                {
+                    continue;
+                }
+
+                for (const unsigned int id : cellIt->second)
+                {
+                    const float distSq = (m_Positions[id] - center).LenSq();
+                    if (distSq < radiusSq && !visitor(id, distSq))
+                    {
+                        return;
+                    }
+                }
+            }
+        }
+    }
+    
+} // VisitSphere
+
+// ---------------------------------------------------------------------------------------------------------------------
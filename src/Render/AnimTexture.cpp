@@ -1,13 +1,13 @@
 ﻿#include "Render/AnimTexture.h"
 
 #include <cstring>
-#include <fstream>
-#include <iostream>
 
+#include "Core/MappedFile.h"
 #include "Core/Quat.h"
 #include "Core/TVec4.h"
 #include "Core/Vec3.h"
 #include "glad/glad.h"
+#include "Render/AnimTextureArchive.h"
 
 // ---------------------------------------------------------------------------------------------------------------------
 
@@ -37,8 +37,12 @@ AnimTexture& AnimTexture::operator=(const AnimTexture& other)
     delete[] m_Data;
     m_Data = nullptr;
     m_Size = other.m_Size;
+    
+    // Mapped texels are read only, both textures can share them
+    m_MappedFile = other.m_MappedFile;
+    m_MappedData = other.m_MappedData;
 
-    if (m_Size == 0)
+    if (m_Size == 0 || other.m_Data == nullptr)
     {
         return *this;
     }
@@ -62,9 +66,21 @@ AnimTexture::~AnimTexture()
 
 // ---------------------------------------------------------------------------------------------------------------------
 
+float* AnimTexture::GetData()
+{
+    DetachFromMappedFile();
+    return m_Data;
+    
+} // GetData
+
+// ---------------------------------------------------------------------------------------------------------------------
+
 void AnimTexture::Resize(unsigned int newSize)
 {
     delete[] m_Data;
+    m_Data = nullptr;
+    m_MappedFile.reset();
+    m_MappedData = nullptr;
 
     m_Size = newSize;
     if (m_Size == 0)
@@ -78,51 +94,36 @@ void AnimTexture::Resize(unsigned int newSize)
 
 // ---------------------------------------------------------------------------------------------------------------------
 
-void AnimTexture::Load(const char* path)
+void AnimTexture::SetMappedData(const std::shared_ptr<MappedFile>& file, const float* data, unsigned size)
 {
-    std::ifstream file;
-    file.open(path, std::ios::in | std::ios::binary);
-    if (!file.is_open())
-    {
-        std::cout << "Couldn't open " << path << std::endl;
-        return;
-    }
+    delete[] m_Data;
+    m_Data = nullptr;
+    
+    m_MappedFile = file;
+    m_MappedData = data;
+    m_Size = size;
+    
+} // SetMappedData
 
-    file >> m_Size;
-    if (m_Size == 0)
+// ---------------------------------------------------------------------------------------------------------------------
+
+bool AnimTexture::Load(const char* path)
+{
+    AnimTextureArchive archive;
+    if (!archive.Open(path) || archive.GetNumClips() == 0)
     {
-        return;
+        return false;
     }
 
-    const unsigned int dataSize = m_Size * m_Size * 4;
-    m_Data = new float[dataSize];
-    file.read(reinterpret_cast<char*>(m_Data), sizeof(float) * dataSize);
-    file.close();
-
-    UploadTextureDataToGPU();
+    return archive.LoadClip(0, *this);
     
 } // Load
 
 // ---------------------------------------------------------------------------------------------------------------------
 
-void AnimTexture::Save(const char* path) const
+bool AnimTexture::Save(const char* path) const
 {
-    std::ofstream file;
-    file.open(path, std::ios::out | std::ios::binary);
-    if (!file.is_open())
-    {
-        std::cout << "Couldn't open " << path << std::endl;
-        return;
-    }
-
-    file << m_Size;
-    if (m_Size == 0)
-    {
-        return;
-    }
-
-    file.write(reinterpret_cast<char*>(m_Data), sizeof(float) * m_Size * m_Size * 4);
-    file.close();
+    return AnimTextureArchive::Save(path, {""}, {this});
     
 } // Save
 
@@ -132,8 +133,10 @@ void AnimTexture::UploadTextureDataToGPU()
 {
     glBindTexture(GL_TEXTURE_2D, m_Handle);
 
+    // Mapped texels go straight from the file pages to the driver
     const auto size = static_cast<GLsizei>(m_Size);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, size, size, 0, GL_RGBA, GL_FLOAT, m_Data);
+    const float* texels = m_MappedData != nullptr ? m_MappedData : m_Data;
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, size, size, 0, GL_RGBA, GL_FLOAT, texels);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -149,6 +152,8 @@ void AnimTexture::UploadTextureDataToGPU()
 
 void AnimTexture::SetTexel(unsigned x, unsigned y, const Vec3& v)
 {
+    DetachFromMappedFile();
+    
     const unsigned int idx = (y * m_Size * 4) + (x * 4);
 
     m_Data[idx + 0] = v.x;
@@ -162,6 +167,8 @@ void AnimTexture::SetTexel(unsigned x, unsigned y, const Vec3& v)
 
 void AnimTexture::SetTexel(unsigned x, unsigned y, const Quat& q)
 {
+    DetachFromMappedFile();
+    
     const unsigned int idx = (y * m_Size * 4) + (x * 4);
 
     m_Data[idx + 0] = q.x;
@@ -176,8 +183,9 @@ void AnimTexture::SetTexel(unsigned x, unsigned y, const Quat& q)
 Vec4 AnimTexture::GetTexel(unsigned x, unsigned y) const
 {
     const unsigned int idx = (y * m_Size * 4) + (x * 4);
+    const float* data = GetData();
 
-    return {m_Data[idx + 0], m_Data[idx + 1], m_Data[idx + 2], m_Data[idx + 3]};
+    return {data[idx + 0], data[idx + 1], data[idx + 2], data[idx + 3]};
     
 } // GetTexel
 
@@ -202,3 +210,21 @@ void AnimTexture::Unset(unsigned textureIdx)
 } // Unset
 
 // ---------------------------------------------------------------------------------------------------------------------
+
+void AnimTexture::DetachFromMappedFile()
+{
+    if (m_MappedData == nullptr)
+    {
+        return;
+    }
+
+    const unsigned int dataSize = m_Size * m_Size * 4;
+    m_Data = new float[dataSize];
+    memcpy(m_Data, m_MappedData, sizeof(float) * dataSize);
+    
+    m_MappedFile.reset();
+    m_MappedData = nullptr;
+    
+} // DetachFromMappedFile
+
+// ---------------------------------------------------------------------------------------------------------------------
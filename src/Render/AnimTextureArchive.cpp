@@ -0,0 +1,254 @@
+﻿#include "Render/AnimTextureArchive.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "Core/MappedFile.h"
+#include "Render/AnimTexture.h"
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+namespace AnimTextureArchiveHelpers
+{
+    inline uint64_t Align(uint64_t offset) 
+    {
+        return (offset + ANIM_TEXTURE_DATA_ALIGNMENT - 1) & ~static_cast<uint64_t>(ANIM_TEXTURE_DATA_ALIGNMENT - 1);
+    }
+
+    inline uint64_t GetTexelBytes(uint32_t width, uint32_t height)
+    {
+        return static_cast<uint64_t>(width) * height * 4 * sizeof(float);
+    }
+    
+} // AnimTextureArchiveHelpers
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+AnimTextureArchive::AnimTextureArchive()
+{
+    
+} // AnimTextureArchive
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+AnimTextureArchive::~AnimTextureArchive()
+{
+    Close();
+    
+} // ~AnimTextureArchive
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+unsigned AnimTextureArchive::GetNumClips() const
+{
+    return m_Header == nullptr ? 0 : m_Header->numClips;
+    
+} // GetNumClips
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+const AnimTextureClipEntry& AnimTextureArchive::GetClipEntry(unsigned idx) const
+{
+    return m_Clips[idx];
+    
+} // GetClipEntry
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+int AnimTextureArchive::FindClip(const std::string& name) const
+{
+    const unsigned int numClips = GetNumClips();
+    for (unsigned int i = 0; i < numClips; ++i)
+    {
+        if (strncmp(m_Clips[i].name, name.c_str(), ANIM_TEXTURE_MAX_NAME) == 0)
+        {
+            return static_cast<int>(i);
+        }
+    }
+
+    return -1;
+    
+} // FindClip
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+bool AnimTextureArchive::Open(const char* path)
+{
+    using namespace AnimTextureArchiveHelpers;
+    
+    Close();
+
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+    if (!file->Open(path))
+    {
+        return false;
+    }
+
+    const uint64_t fileSize = file->GetSize();
+    const unsigned char* fileData = file->GetData();
+    if (fileSize < sizeof(AnimTextureFileHeader))
+    {
+        std::cout << "Invalid anim texture file: " << path << std::endl;
+        return false;
+    }
+
+    const auto* header = reinterpret_cast<const AnimTextureFileHeader*>(fileData);
+    if (header->magic != ANIM_TEXTURE_MAGIC || header->version != ANIM_TEXTURE_VERSION)
+    {
+        std::cout << "Unsupported anim texture file (magic/version): " << path << std::endl;
+        return false;
+    }
+
+    const uint64_t tableEnd = header->clipTableOffset +
+        static_cast<uint64_t>(header->numClips) * sizeof(AnimTextureClipEntry);
+    if (tableEnd > fileSize)
+    {
+        std::cout << "Truncated anim texture clip table: " << path << std::endl;
+        return false;
+    }
+
+    const auto* clips = reinterpret_cast<const AnimTextureClipEntry*>(fileData + header->clipTableOffset);
+    for (unsigned int i = 0; i < header->numClips; ++i)
+    {
+        const AnimTextureClipEntry& entry = clips[i];
+        const bool bValidEntry = entry.format == AnimTextureFormat::RGBA32F && entry.width == entry.height &&
+            entry.dataSize == GetTexelBytes(entry.width, entry.height) && entry.dataOffset % sizeof(float) == 0 &&
+            entry.dataOffset + entry.dataSize <= fileSize;
+        if (!bValidEntry)
+        {
+            std::cout << "Invalid anim texture clip entry " << i << ": " << path << std::endl;
+            return false;
+        }
+    }
+
+    m_File = file;
+    m_Header = header;
+    m_Clips = clips;
+    return true;
+    
+} // Open
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void AnimTextureArchive::Close()
+{
+    // Textures loaded from this archive keep the mapping alive
+    m_File.reset();
+    m_Header = nullptr;
+    m_Clips = nullptr;
+    
+} // Close
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+bool AnimTextureArchive::LoadClip(unsigned idx, AnimTexture& outTex, bool bVerifyChecksum) const
+{
+    if (idx >= GetNumClips())
+    {
+        return false;
+    }
+
+    const AnimTextureClipEntry& entry = m_Clips[idx];
+    const auto* texels = reinterpret_cast<const float*>(m_File->GetData() + entry.dataOffset);
+    
+    if (bVerifyChecksum && Checksum(texels, entry.dataSize / sizeof(float)) != entry.checksum)
+    {
+        std::cout << "Checksum mismatch on anim texture clip " << entry.name << std::endl;
+        return false;
+    }
+
+    outTex.SetMappedData(m_File, texels, entry.width);
+    outTex.UploadTextureDataToGPU();
+    return true;
+    
+} // LoadClip
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+bool AnimTextureArchive::Save(const char* path, const std::vector<std::string>& names,
+    const std::vector<const AnimTexture*>& textures)
+{
+    using namespace AnimTextureArchiveHelpers;
+    
+    const unsigned int numClips = textures.size();
+    if (names.size() != numClips)
+    {
+        std::cout << "Anim texture archive needs one name per texture" << std::endl;
+        return false;
+    }
+
+    AnimTextureFileHeader header = {};
+    header.magic = ANIM_TEXTURE_MAGIC;
+    header.version = ANIM_TEXTURE_VERSION;
+    header.numClips = numClips;
+    header.clipTableOffset = sizeof(AnimTextureFileHeader);
+
+    // Build the clip table first so texel offsets are known
+    std::vector<AnimTextureClipEntry> entries(numClips);
+    uint64_t offset = Align(header.clipTableOffset + numClips * sizeof(AnimTextureClipEntry));
+    
+    for (unsigned int i = 0; i < numClips; ++i)
+    {
+        const AnimTexture& texture = *textures[i];
+        AnimTextureClipEntry& entry = entries[i];
+        memset(&entry, 0, sizeof(AnimTextureClipEntry));
+        strncpy(entry.name, names[i].c_str(), ANIM_TEXTURE_MAX_NAME - 1);
+        
+        entry.width = texture.GetSize();
+        entry.height = texture.GetSize();
+        entry.format = AnimTextureFormat::RGBA32F;
+        entry.dataOffset = offset;
+        entry.dataSize = GetTexelBytes(entry.width, entry.height);
+        entry.checksum = entry.dataSize == 0 ? 0 : Checksum(texture.GetData(), entry.dataSize / sizeof(float));
+        
+        offset = Align(offset + entry.dataSize);
+    }
+
+    std::ofstream file;
+    file.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+        std::cout << "Couldn't open " << path << std::endl;
+        return false;
+    }
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(AnimTextureFileHeader));
+    file.write(reinterpret_cast<const char*>(entries.data()), numClips * sizeof(AnimTextureClipEntry));
+
+    static const char PADDING[ANIM_TEXTURE_DATA_ALIGNMENT] = {};
+    for (unsigned int i = 0; i < numClips; ++i)
+    {
+        const uint64_t padding = entries[i].dataOffset - static_cast<uint64_t>(file.tellp());
+        file.write(PADDING, static_cast<std::streamsize>(padding));
+        file.write(reinterpret_cast<const char*>(textures[i]->GetData()),
+            static_cast<std::streamsize>(entries[i].dataSize));
+    }
+
+    const bool bSuccess = file.good();
+    file.close();
+    return bSuccess;
+    
+} // Save
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+uint32_t AnimTextureArchive::Checksum(const float* data, uint64_t numFloats)
+{
+    // FNV-1a on 32 bit words instead of bytes, a quarter of the iterations over the texel data
+    static constexpr uint32_t FNV_OFFSET = 2166136261u;
+    static constexpr uint32_t FNV_PRIME = 16777619u;
+
+    uint32_t hash = FNV_OFFSET;
+    for (uint64_t i = 0; i < numFloats; ++i)
+    {
+        uint32_t word;
+        memcpy(&word, data + i, sizeof(uint32_t));
+        hash = (hash ^ word) * FNV_PRIME;
+    }
+
+    return hash;
+    
+} // Checksum
+
+// ---------------------------------------------------------------------------------------------------------------------
@@ -4,6 +4,7 @@
 #include "Core/Vec3.h"
 #include "IK/CCDSolver.h"
 #include "IK/FABRIKSolver.h"
+#include "IK/TwoBoneIKSolver.h"
 #include "Render/Attribute.h"
 #include "Render/Draw.h"
 #include "Render/Shader.h"
@@ -225,3 +226,32 @@ void DebugDrawer::PointsFromIKSolver(const FABRIKSolver& solver)
 } // PointsFromIKSolver
 
 // ---------------------------------------------------------------------------------------------------------------------
+
+void DebugDrawer::LinesFromIKSolver(const TwoBoneIKSolver& solver)
+{
+    const unsigned int size = solver.GetSize();
+    m_Points.resize((size - 1) * 2);
+    
+    for (unsigned int i = 0; i < size - 1; ++i)
+    {
+        m_Points[2*i] = solver.GetGlobalTransform(i).position;
+        m_Points[2*i+1] = solver.GetGlobalTransform(i + 1).position;
+    }
+    
+} // LinesFromIKSolver
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void DebugDrawer::PointsFromIKSolver(const TwoBoneIKSolver& solver)
+{
+    const unsigned int requiredVerts = solver.GetSize();
+    m_Points.resize(requiredVerts);
+
+    for (unsigned int i = 0; i < requiredVerts; ++i)
+    {
+        m_Points[i] = solver.GetGlobalTransform(i).position;
+    }
+    
+} // PointsFromIKSolver
+
+// ---------------------------------------------------------------------------------------------------------------------
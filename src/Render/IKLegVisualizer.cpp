@@ -0,0 +1,55 @@
+﻿#include "Render/IKLegVisualizer.h"
+
+#include "Core/Transform.h"
+#include "IK/IKLeg.h"
+#include "SkeletalMesh/Pose.h"
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+IKLegVisualizer::IKLegVisualizer() : m_Lines(4), m_Points(3)
+{
+    
+} // IKLegVisualizer
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void IKLegVisualizer::FromSolver(const IKLeg& leg)
+{
+    m_Lines.LinesFromIKSolver(leg.GetSolver());
+    m_Points.PointsFromIKSolver(leg.GetSolver());
+    
+} // FromSolver
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void IKLegVisualizer::FromPose(const IKLeg& leg, const Transform& model, const Pose& pose)
+{
+    const Transform hip = model.Combine(pose.GetGlobalTransform(leg.GetHipIdx()));
+    const Transform knee = hip.Combine(pose.GetLocalTransform(leg.GetKneeIdx()));
+    const Transform ankle = knee.Combine(pose.GetLocalTransform(leg.GetAnkleIdx()));
+
+    m_Lines.Resize(4);
+    m_Lines[0] = hip.position;
+    m_Lines[1] = knee.position;
+    m_Lines[2] = knee.position;
+    m_Lines[3] = ankle.position;
+
+    m_Points.Resize(3);
+    m_Points[0] = hip.position;
+    m_Points[1] = knee.position;
+    m_Points[2] = ankle.position;
+    
+} // FromPose
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void IKLegVisualizer::Draw(const Mat4& mvp, const Vec3& color)
+{
+    m_Lines.UpdateOpenGLBuffers();
+    m_Points.UpdateOpenGLBuffers();
+    m_Lines.Draw(DebugDrawMode::Lines, color, mvp);
+    m_Points.Draw(DebugDrawMode::Points, color, mvp);
+    
+} // Draw
+
+// ---------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,516 @@
+﻿#include "SkeletalMesh/MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "Core/TVec2.h"
+#include "Core/TVec4.h"
+#include "Core/Vec3.h"
+#include "SkeletalMesh/MorphTarget.h"
+#include "SkeletalMesh/SkeletalMesh.h"
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+namespace MeshOptimizerHelpers
+{
+    static constexpr unsigned int INVALID_INDEX = ~0u;
+
+    // Streams are optional (static meshes have no weights), only the ones with one entry per vertex are used
+    inline bool AreIndicesValid(const std::vector<unsigned int>& indices, unsigned int numVertices)
+    {
+        return std::all_of(indices.begin(), indices.end(), [numVertices](unsigned int i) { return i < numVertices; });
+    }
+
+    template <typename T>
+    bool HasStream(const std::vector<T>& stream, unsigned int numVertices)
+    {
+        return !stream.empty() && stream.size() == numVertices;
+    }
+
+    // FNV-1a 64 over the raw attribute bytes
+    inline void HashBytes(uint64_t& hash, const void* data, std::size_t numBytes)
+    {
+        const auto* bytes = static_cast<const unsigned char*>(data);
+        for (std::size_t i = 0; i < numBytes; ++i)
+        {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+    }
+
+    template <typename T>
+    void HashStream(uint64_t& hash, const std::vector<T>& stream, unsigned int numVertices, unsigned int v)
+    {
+        if (HasStream(stream, numVertices))
+        {
+            HashBytes(hash, &stream[v], sizeof(T));
+        }
+    }
+
+    template <typename T>
+    bool StreamEqual(const std::vector<T>& stream, unsigned int numVertices, unsigned int a, unsigned int b)
+    {
+        return !HasStream(stream, numVertices) || memcmp(&stream[a], &stream[b], sizeof(T)) == 0;
+    }
+
+    // Moves vertex v to remap[v], newCount is the size after the remap
+    template <typename T>
+    void RemapStream(std::vector<T>& stream, unsigned int numVertices, const std::vector<unsigned int>& remap,
+        unsigned int newCount)
+    {
+        if (!HasStream(stream, numVertices))
+        {
+            return;
+        }
+
+        std::vector<T> result(newCount);
+        for (unsigned int v = 0; v < numVertices; ++v)
+        {
+            result[remap[v]] = stream[v];
+        }
+        stream.swap(result);
+    }
+
+    // Dense position and normal deltas of every target per vertex, so welding only merges vertices every target
+    // moves the same way. Empty when the mesh has no morph targets
+    inline std::vector<Vec3> GetVertexMorphDeltas(const SkeletalMesh& mesh, unsigned int numVertices,
+        unsigned int& outStride)
+    {
+        const std::vector<MorphTarget>& targets = mesh.GetMorphTargets();
+        outStride = targets.size() * 2;
+        
+        std::vector<Vec3> result(numVertices * outStride, Vec3{0.f, 0.f, 0.f});
+        for (unsigned int t = 0; t < targets.size(); ++t)
+        {
+            const MorphTarget& target = targets[t];
+            for (unsigned int i = 0; i < target.vertices.size(); ++i)
+            {
+                const unsigned int base = target.vertices[i] * outStride + t * 2;
+                result[base] = target.positionDeltas[i];
+                result[base + 1] = target.normalDeltas.empty() ? Vec3{0.f, 0.f, 0.f} : target.normalDeltas[i];
+            }
+        }
+
+        return result;
+    }
+
+    // Welded vertices have identical deltas, so only the first entry of each new vertex is kept
+    inline void RemapMorphTarget(MorphTarget& target, const std::vector<unsigned int>& remap)
+    {
+        const unsigned int numDeltas = target.vertices.size();
+        std::vector<unsigned int> order(numDeltas);
+        for (unsigned int i = 0; i < numDeltas; ++i)
+        {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [&target, &remap](unsigned int a, unsigned int b)
+        {
+            return remap[target.vertices[a]] < remap[target.vertices[b]];
+        });
+
+        const bool bHasNormals = !target.normalDeltas.empty();
+        MorphTarget result;
+        result.name = target.name;
+        result.vertices.reserve(numDeltas);
+        result.positionDeltas.reserve(numDeltas);
+        result.normalDeltas.reserve(bHasNormals ? numDeltas : 0);
+        
+        for (const unsigned int i : order)
+        {
+            const unsigned int v = remap[target.vertices[i]];
+            if (!result.vertices.empty() && result.vertices.back() == v)
+            {
+                continue;
+            }
+
+            result.vertices.push_back(v);
+            result.positionDeltas.push_back(target.positionDeltas[i]);
+            if (bHasNormals)
+            {
+                result.normalDeltas.push_back(target.normalDeltas[i]);
+            }
+        }
+
+        target = std::move(result);
+    }
+
+    inline void RemapVertices(SkeletalMesh& mesh, const std::vector<unsigned int>& remap, unsigned int newCount)
+    {
+        const unsigned int numVertices = mesh.GetPosition().size();
+        RemapStream(mesh.GetPosition(), numVertices, remap, newCount);
+        RemapStream(mesh.GetNormal(), numVertices, remap, newCount);
+        RemapStream(mesh.GetTexCoord(), numVertices, remap, newCount);
+        RemapStream(mesh.GetBonesWeight(), numVertices, remap, newCount);
+        RemapStream(mesh.GetBonesID(), numVertices, remap, newCount);
+
+        for (unsigned int& index : mesh.GetIndices())
+        {
+            index = remap[index];
+        }
+
+        for (MorphTarget& target : mesh.GetMorphTargets())
+        {
+            RemapMorphTarget(target, remap);
+        }
+    }
+
+    // Forsyth's vertex score: recently used vertices and vertices with few triangles left score higher
+    static constexpr int VERTEX_CACHE_SIZE = 32;
+    
+    inline float GetVertexScore(int cachePosition, unsigned int numActiveTriangles)
+    {
+        static constexpr float CACHE_DECAY_POWER = 1.5f;
+        static constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+        static constexpr float VALENCE_BOOST_SCALE = 2.f;
+        static constexpr float VALENCE_BOOST_POWER = 0.5f;
+        
+        if (numActiveTriangles == 0)
+        {
+            return -1.f;
+        }
+
+        float score = 0.f;
+        if (cachePosition >= 0)
+        {
+            if (cachePosition < 3)
+            {
+                // Vertices of the last triangle get a fixed score so it isn't emitted twice in a row
+                score = LAST_TRIANGLE_SCORE;
+            }
+            else
+            {
+                const float scaler = 1.f / static_cast<float>(VERTEX_CACHE_SIZE - 3);
+                score = powf(1.f - static_cast<float>(cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+            }
+        }
+
+        return score + VALENCE_BOOST_SCALE * powf(static_cast<float>(numActiveTriangles), -VALENCE_BOOST_POWER);
+    }
+    
+} // MeshOptimizerHelpers
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void MeshOptimizer::Optimize(SkeletalMesh& mesh)
+{
+    WeldVertices(mesh);
+    OptimizeVertexCache(mesh);
+    OptimizeVertexFetch(mesh);
+    
+} // Optimize
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+unsigned MeshOptimizer::WeldVertices(SkeletalMesh& mesh)
+{
+    using namespace MeshOptimizerHelpers;
+    
+    const unsigned int numVertices = mesh.GetPosition().size();
+    std::vector<unsigned int>& indices = mesh.GetIndices();
+    if (numVertices == 0 || (indices.empty() && numVertices % 3 != 0) || !AreIndicesValid(indices, numVertices))
+    {
+        return 0;
+    }
+
+    if (indices.empty())
+    {
+        indices.resize(numVertices);
+        for (unsigned int i = 0; i < numVertices; ++i)
+        {
+            indices[i] = i;
+        }
+    }
+
+    // Open addressing table of unique vertices, at most half full
+    unsigned int tableSize = 1;
+    while (tableSize < numVertices * 2)
+    {
+        tableSize <<= 1;
+    }
+    std::vector<unsigned int> table(tableSize, INVALID_INDEX);
+
+    unsigned int morphStride;
+    const std::vector<Vec3> morphDeltas = GetVertexMorphDeltas(mesh, numVertices, morphStride);
+    const std::size_t morphBytes = morphStride * sizeof(Vec3);
+
+    std::vector<unsigned int> remap(numVertices);
+    unsigned int numUnique = 0;
+    
+    for (unsigned int v = 0; v < numVertices; ++v)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        HashStream(hash, mesh.GetPosition(), numVertices, v);
+        HashStream(hash, mesh.GetNormal(), numVertices, v);
+        HashStream(hash, mesh.GetTexCoord(), numVertices, v);
+        HashStream(hash, mesh.GetBonesWeight(), numVertices, v);
+        HashStream(hash, mesh.GetBonesID(), numVertices, v);
+        if (morphStride > 0)
+        {
+            HashBytes(hash, &morphDeltas[v * morphStride], morphBytes);
+        }
+
+        unsigned int slot = static_cast<unsigned int>(hash ^ (hash >> 32)) & (tableSize - 1);
+        while (true)
+        {
+            const unsigned int other = table[slot];
+            if (other == INVALID_INDEX)
+            {
+                table[slot] = v;
+                remap[v] = numUnique++;
+                break;
+            }
+
+            const bool bEqual = StreamEqual(mesh.GetPosition(), numVertices, v, other) &&
+                StreamEqual(mesh.GetNormal(), numVertices, v, other) &&
+                StreamEqual(mesh.GetTexCoord(), numVertices, v, other) &&
+                StreamEqual(mesh.GetBonesWeight(), numVertices, v, other) &&
+                StreamEqual(mesh.GetBonesID(), numVertices, v, other) && (morphStride == 0 ||
+                memcmp(&morphDeltas[v * morphStride], &morphDeltas[other * morphStride], morphBytes) == 0);
+            if (bEqual)
+            {
+                remap[v] = remap[other];
+                break;
+            }
+
+            slot = (slot + 1) & (tableSize - 1);
+        }
+    }
+
+    if (numUnique == numVertices)
+    {
+        return 0;
+    }
+
+    RemapVertices(mesh, remap, numUnique);
+    return numVertices - numUnique;
+    
+} // WeldVertices
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void MeshOptimizer::OptimizeVertexCache(SkeletalMesh& mesh)
+{
+    using namespace MeshOptimizerHelpers;
+    
+    std::vector<unsigned int>& indices = mesh.GetIndices();
+    const unsigned int numVertices = mesh.GetPosition().size();
+    const unsigned int numTriangles = indices.size() / 3;
+    if (numTriangles <= 1 || indices.size() % 3 != 0 || !AreIndicesValid(indices, numVertices))
+    {
+        return;
+    }
+
+    // Triangles of each vertex, packed: vertex v owns [firstTriangle[v], firstTriangle[v] + numActive[v])
+    std::vector<unsigned int> numActive(numVertices, 0);
+    for (const unsigned int index : indices)
+    {
+        ++numActive[index];
+    }
+
+    std::vector<unsigned int> firstTriangle(numVertices + 1, 0);
+    for (unsigned int v = 0; v < numVertices; ++v)
+    {
+        firstTriangle[v + 1] = firstTriangle[v] + numActive[v];
+    }
+
+    std::vector<unsigned int> vertexTriangles(indices.size());
+    std::vector<unsigned int> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+    for (unsigned int t = 0; t < numTriangles; ++t)
+    {
+        for (unsigned int k = 0; k < 3; ++k)
+        {
+            const unsigned int v = indices[t * 3 + k];
+            vertexTriangles[fill[v]++] = t;
+        }
+    }
+
+    std::vector<int> cachePosition(numVertices, -1);
+    std::vector<float> vertexScore(numVertices);
+    for (unsigned int v = 0; v < numVertices; ++v)
+    {
+        vertexScore[v] = GetVertexScore(-1, numActive[v]);
+    }
+
+    std::vector<float> triangleScore(numTriangles);
+    std::vector<bool> bEmitted(numTriangles, false);
+    for (unsigned int t = 0; t < numTriangles; ++t)
+    {
+        triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] +
+            vertexScore[indices[t * 3 + 2]];
+    }
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    
+    // The simulated cache can hold 3 extra vertices while the new triangle is pushed
+    std::vector<unsigned int> cache;
+    std::vector<unsigned int> newCache;
+    cache.reserve(VERTEX_CACHE_SIZE + 3);
+    newCache.reserve(VERTEX_CACHE_SIZE + 3);
+
+    unsigned int bestTriangle = INVALID_INDEX;
+    unsigned int scanCursor = 0;
+    
+    for (unsigned int emitted = 0; emitted < numTriangles; ++emitted)
+    {
+        // No candidate in the cache, take the best remaining triangle from a linear scan
+        if (bestTriangle == INVALID_INDEX)
+        {
+            float bestScore = -1.f;
+            for (unsigned int t = scanCursor; t < numTriangles; ++t)
+            {
+                if (!bEmitted[t] && triangleScore[t] > bestScore)
+                {
+                    bestScore = triangleScore[t];
+                    bestTriangle = t;
+                }
+            }
+        }
+
+        bEmitted[bestTriangle] = true;
+        while (scanCursor < numTriangles && bEmitted[scanCursor])
+        {
+            ++scanCursor;
+        }
+
+        // Emit and remove the triangle from the active list of its vertices
+        newCache.clear();
+        for (unsigned int k = 0; k < 3; ++k)
+        {
+            const unsigned int v = indices[bestTriangle * 3 + k];
+            result.push_back(v);
+            newCache.push_back(v);
+
+            unsigned int* first = &vertexTriangles[firstTriangle[v]];
+            unsigned int* last = first + numActive[v];
+            std::iter_swap(std::find(first, last, bestTriangle), last - 1);
+            --numActive[v];
+        }
+
+        for (const unsigned int v : cache)
+        {
+            if (v != newCache[0] && v != newCache[1] && v != newCache[2])
+            {
+                newCache.push_back(v);
+            }
+        }
+
+        // Vertices pushed out of the cache lose their cache score
+        const unsigned int newCacheSize = newCache.size();
+        for (unsigned int i = VERTEX_CACHE_SIZE; i < newCacheSize; ++i)
+        {
+            const unsigned int v = newCache[i];
+            cachePosition[v] = -1;
+            vertexScore[v] = GetVertexScore(-1, numActive[v]);
+        }
+        newCache.resize(std::min<unsigned int>(newCacheSize, VERTEX_CACHE_SIZE));
+        cache.swap(newCache);
+
+        const unsigned int cacheSize = cache.size();
+        for (unsigned int i = 0; i < cacheSize; ++i)
+        {
+            const unsigned int v = cache[i];
+            cachePosition[v] = static_cast<int>(i);
+            vertexScore[v] = GetVertexScore(cachePosition[v], numActive[v]);
+        }
+
+        // Only triangles touching the cache changed score, the next one is picked among them
+        bestTriangle = INVALID_INDEX;
+        float bestScore = -1.f;
+        for (const unsigned int v : cache)
+        {
+            const unsigned int first = firstTriangle[v];
+            for (unsigned int i = first; i < first + numActive[v]; ++i)
+            {
+                const unsigned int t = vertexTriangles[i];
+                triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] +
+                    vertexScore[indices[t * 3 + 2]];
+                if (triangleScore[t] > bestScore)
+                {
+                    bestScore = triangleScore[t];
+                    bestTriangle = t;
+                }
+            }
+        }
+    }
+
+    indices.swap(result);
+    
+} // OptimizeVertexCache
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void MeshOptimizer::OptimizeVertexFetch(SkeletalMesh& mesh)
+{
+    using namespace MeshOptimizerHelpers;
+    
+    const unsigned int numVertices = mesh.GetPosition().size();
+    const std::vector<unsigned int>& indices = mesh.GetIndices();
+    if (numVertices == 0 || indices.empty() || !AreIndicesValid(indices, numVertices))
+    {
+        return;
+    }
+
+    std::vector<unsigned int> remap(numVertices, INVALID_INDEX);
+    unsigned int next = 0;
+    for (const unsigned int index : indices)
+    {
+        if (remap[index] == INVALID_INDEX)
+        {
+            remap[index] = next++;
+        }
+    }
+
+    // Unreferenced vertices are kept at the end
+    for (unsigned int& index : remap)
+    {
+        if (index == INVALID_INDEX)
+        {
+            index = next++;
+        }
+    }
+
+    RemapVertices(mesh, remap, numVertices);
+    
+} // OptimizeVertexFetch
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+float MeshOptimizer::GetACMR(const std::vector<unsigned>& indices, unsigned cacheSize)
+{
+    const unsigned int numTriangles = indices.size() / 3;
+    if (numTriangles == 0 || cacheSize == 0)
+    {
+        return 0.f;
+    }
+
+    std::vector<unsigned int> cache;
+    cache.reserve(cacheSize);
+    unsigned int cacheHead = 0;
+    unsigned int numMisses = 0;
+    
+    for (const unsigned int index : indices)
+    {
+        if (std::find(cache.begin(), cache.end(), index) != cache.end())
+        {
+            continue;
+        }
+
+        ++numMisses;
+        if (cache.size() < cacheSize)
+        {
+            cache.push_back(index);
+        }
+        else
+        {
+            cache[cacheHead] = index;
+            cacheHead = (cacheHead + 1) % cacheSize;
+        }
+    }
+
+    return static_cast<float>(numMisses) / static_cast<float>(numTriangles);
+    
+} // GetACMR
+
+// ---------------------------------------------------------------------------------------------------------------------
@@ -149,6 +149,35 @@ DualQuaternion Pose::GetGlobalDualQuaternion(unsigned idx) const
 
 // ---------------------------------------------------------------------------------------------------------------------
 
+void Pose::GetGlobalTransforms(std::vector<Transform>& out) const
+{
+    const int size = static_cast<int>(GetSize());
+    out.resize(size);
+
+    int i = 0;
+
+    // Optimized method only for ordered bones
+    for (; i < size; ++i)
+    {
+        const int parent = m_Parents[i];
+        if (parent > i)
+        {
+            break;
+        }
+
+        out[i] = parent >= 0 ? out[parent].Combine(m_Joints[i]) : m_Joints[i];
+    }
+
+    // If not ordered, use unoptimized method
+    for (; i < size; ++i)
+    {
+        out[i] = GetGlobalTransform(i);
+    }
+    
+} // GetGlobalTransforms
+
+// ---------------------------------------------------------------------------------------------------------------------
+
 void Pose::GetMatrixPalette(std::vector<Mat4>& out) const
 {
     const int size = static_cast<int>(GetSize());
@@ -1,5 +1,9 @@
 ﻿#include "SkeletalMesh/SkeletalMesh.h"
 
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
 #include "Core/Mat4.h"
 #include "Core/Transform.h"
 #include "Core/TVec2.h"
@@ -8,6 +12,7 @@
 #include "Render/Attribute.h"
 #include "Render/Draw.h"
 #include "Render/IndexBuffer.h"
+#include "SkeletalMesh/MorphTarget.h"
 #include "SkeletalMesh/Skeleton.h"
 #include "SkeletalMesh/TriangleMesh.h"
 
@@ -24,9 +29,11 @@ SkeletalMesh::SkeletalMesh() : m_PositionAttribute(new Attribute<Vec3>()), m_Nor
 
 SkeletalMesh::SkeletalMesh(const SkeletalMesh& other) : m_Position(other.m_Position), m_Normal(other.m_Normal),
     m_TexCoords(other.m_TexCoords), m_BonesWeight(other.m_BonesWeight), m_BonesID(other.m_BonesID),
-    m_Indices(other.m_Indices), m_PositionAttribute(new Attribute<Vec3>()), m_NormalAttribute(new Attribute<Vec3>()),
-    m_UVAttribute(new Attribute<Vec2>()), m_BonesWeightAttribute(new Attribute<Vec4>()),
-    m_BonesIDAttribute(new Attribute<IVec4>()), m_IndexBuffer(new IndexBuffer())
+    m_Indices(other.m_Indices), m_MorphTargets(other.m_MorphTargets),
+    m_DefaultMorphWeights(other.m_DefaultMorphWeights), m_PositionAttribute(new Attribute<Vec3>()),
+    m_NormalAttribute(new Attribute<Vec3>()), m_UVAttribute(new Attribute<Vec2>()),
+    m_BonesWeightAttribute(new Attribute<Vec4>()), m_BonesIDAttribute(new Attribute<IVec4>()),
+    m_IndexBuffer(new IndexBuffer())
 {
     UpdateOpenGLBuffers();
     
@@ -47,6 +54,8 @@ SkeletalMesh& SkeletalMesh::operator=(const SkeletalMesh& other)
     m_BonesWeight = other.m_BonesWeight;
     m_BonesID = other.m_BonesID;
     m_Indices = other.m_Indices;
+    m_MorphTargets = other.m_MorphTargets;
+    m_DefaultMorphWeights = other.m_DefaultMorphWeights;
     UpdateOpenGLBuffers();
 
     return *this;
@@ -198,33 +207,7 @@ void SkeletalMesh::DrawInstanced(unsigned numInstances) const
 
 void SkeletalMesh::CPUSkin(const Skeleton& skeleton, const Pose& pose)
 {
-    const unsigned int numVerts = m_Position.size();
-    if (numVerts == 0)
-    {
-        return;
-    }
-    
-    m_SkinnedPosition.resize(numVerts);
-    m_SkinnedNormal.resize(numVerts);
-
-    pose.GetMatrixPalette(m_PosePalette);
-    const std::vector<Mat4>& invPosePalette = skeleton.GetInvBindPose();
-
-    for (unsigned int i = 0; i < numVerts; ++i)
-    {
-        Mat4 skinMatrix = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-        for (unsigned int j = 0; j < 4; ++j)
-        {
-            int boneID = m_BonesID[i][j];
-            skinMatrix += m_PosePalette[boneID] * invPosePalette[boneID] * m_BonesWeight[i][j];
-        }
-        
-        m_SkinnedPosition[i] = skinMatrix.TransformPoint(m_Position[i]);
-        m_SkinnedNormal[i] = skinMatrix.TransformVector(m_Normal[i]);
-    }
-    
-    m_PositionAttribute->Set(m_SkinnedPosition);
-    m_NormalAttribute->Set(m_SkinnedNormal);
+    SkinVertices(skeleton, pose, m_Position, m_Normal);
     
 } // CPUSkin
 
@@ -263,14 +246,84 @@ void SkeletalMesh::CPUSkin(const std::vector<Mat4>& animatedPose)
 
 // ---------------------------------------------------------------------------------------------------------------------
 
-void SkeletalMesh::RearrangeMesh(const BoneMap& boneMap)
+void SkeletalMesh::CPUMorphAndSkin(const Skeleton& skeleton, const Pose& pose, const std::vector<float>& morphWeights)
 {
-    for (IVec4& bonesID : m_BonesID)
+    static constexpr float MIN_MORPH_WEIGHT = 1e-4f;
+    
+    const unsigned int numTargets = std::min<unsigned int>(m_MorphTargets.size(), morphWeights.size());
+    bool bMorphed = false;
+    
+    for (unsigned int t = 0; t < numTargets; ++t)
     {
-        for (unsigned int i = 0; i < 4; ++i)
+        const float weight = morphWeights[t];
+        if (fabsf(weight) < MIN_MORPH_WEIGHT)
+        {
+            continue;
+        }
+
+        // Copy the base mesh only once some target is active, most frames of a face have few
+        if (!bMorphed)
         {
-            bonesID[i] = boneMap.at(bonesID[i]);
+            m_MorphedPosition = m_Position;
+            m_MorphedNormal = m_Normal;
+            bMorphed = true;
         }
+
+        const MorphTarget& target = m_MorphTargets[t];
+        const unsigned int numDeltas = target.vertices.size();
+        for (unsigned int i = 0; i < numDeltas; ++i)
+        {
+            m_MorphedPosition[target.vertices[i]] += target.positionDeltas[i] * weight;
+        }
+
+        if (!target.normalDeltas.empty() && !m_MorphedNormal.empty())
+        {
+            for (unsigned int i = 0; i < numDeltas; ++i)
+            {
+                m_MorphedNormal[target.vertices[i]] += target.normalDeltas[i] * weight;
+            }
+        }
+    }
+
+    if (bMorphed)
+    {
+        SkinVertices(skeleton, pose, m_MorphedPosition, m_MorphedNormal);
+    }
+    else
+    {
+        SkinVertices(skeleton, pose, m_Position, m_Normal);
+    }
+    
+} // CPUMorphAndSkin
+
+// ---------------------------------------------------------------------------------------------------------------------
+
+void SkeletalMesh::RearrangeMesh(const BoneMap& boneMap)
+{
+    if (boneMap.empty())
+    {
+        std::cout << "Invalid bone map, mesh not rearranged" << std::endl;
+        return;
+    }
+    
+    // IVec4s are contiguous ints, so every influence is remapped in one flat gather loop. IDs the map doesn't know
+    // are bound to the root instead of reading past it
+    const unsigned int numIDs = m_BonesID.size() * 4;
+    int* bonesID = m_BonesID.empty() ? nullptr : m_BonesID[0].v;
+    const int* remap = boneMap.data() + 1;
+    const int numBones = static_cast<int>(boneMap.size()) - 1;
+    unsigned int numInvalidIDs = 0;
+    for (unsigned int i = 0; i < numIDs; ++i)
+    {
+        const int oldID = bonesID[i];
+        const bool bValid = oldID >= -1 && oldID < numBones;
+        bonesID[i] = bValid ? remap[oldID] : 0;
+        numInvalidIDs += bValid ? 0 : 1;
+    }
+
+    if (numInvalidIDs > 0)
+    {
+        std::cout << numInvalidIDs << " bone influences out of the bone map range, bound to the root" << std::endl;
     }
 
     UpdateOpenGLBuffers();
@@ -279,6 +332,41 @@ void SkeletalMesh::RearrangeMesh(const BoneMap& boneMap)
 
 // ---------------------------------------------------------------------------------------------------------------------
 
+void SkeletalMesh::SkinVertices(const Skeleton& skeleton, const Pose& pose, const std::vector<Vec3>& positions,
+    const std::vector<Vec3>& normals)
+{
+    const unsigned int numVerts = positions.size();
+    if (numVerts == 0)
+    {
+        return;
+    }
+    
+    m_SkinnedPosition.resize(numVerts);
+    m_SkinnedNormal.resize(numVerts);
+
+    pose.GetMatrixPalette(m_PosePalette);
+    const std::vector<Mat4>& invPosePalette = skeleton.GetInvBindPose();
+
+    for (unsigned int i = 0; i < numVerts; ++i)
+    {
+        Mat4 skinMatrix = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+        for (unsigned int j = 0; j < 4; ++j)
+        {
+            int boneID = m_BonesID[i][j];
+            skinMatrix += m_PosePalette[boneID] * invPosePalette[boneID] * m_BonesWeight[i][j];
+        }
+        
+        m_SkinnedPosition[i] = skinMatrix.TransformPoint(positions[i]);
+        m_SkinnedNormal[i] = skinMatrix.TransformVector(normals[i]);
+    }
+    
+    m_PositionAttribute->Set(m_SkinnedPosition);
+    m_NormalAttribute->Set(m_SkinnedNormal);
+    
+} // SkinVertices
+
+// ---------------------------------------------------------------------------------------------------------------------
+
 std::vector<TriangleMesh> SkeletalMesh::GetTriangles() const
 {
     std::vector<TriangleMesh> triangles;
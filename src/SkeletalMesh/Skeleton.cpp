@@ -1,6 +1,6 @@
 ﻿#include "SkeletalMesh/Skeleton.h"
 
-#include <list>
+#include <cstddef>
 
 #include "Core/DualQuaternion.h"
 #include "Core/Mat4.h"
@@ -95,11 +95,13 @@ BoneMap Skeleton::RearrangeSkeleton()
     const unsigned int size = m_RestPose.GetSize();
     if (size == 0)
     {
-        return {};
+        // Still holds the -1 sentinel, so users can always index it with old ID + 1
+        return BoneMap(1, -1);
     }
 
     std::vector<std::vector<unsigned int>> hierarchy(size);
-    std::list<unsigned int> process;
+    std::vector<unsigned int> process;
+    process.reserve(size);
 
     for (unsigned int i = 0; i < size; ++i)
     {
@@ -114,24 +116,21 @@ BoneMap Skeleton::RearrangeSkeleton()
         }
     }
 
-    BoneMap oldToNewID;
-    BoneMap newToOldID;
-    
-    for (unsigned int newID = 0; newID < size; ++newID, process.pop_front())
+    // Breadth first, process works as a queue that's never popped so the visit order is the new to old table
+    for (std::size_t head = 0; head < process.size(); ++head)
     {
-        const int oldID = static_cast<int>(process.front());
-        const int iNewID = static_cast<int>(newID);
-        newToOldID[iNewID] = oldID;
-        oldToNewID[oldID] = iNewID;
-        
-        for (const unsigned int childrenID : hierarchy[oldID])
+        for (const unsigned int childrenID : hierarchy[process[head]])
         {
             process.push_back(childrenID);
         }
     }
+    const std::vector<unsigned int>& newToOldID = process;
 
-    oldToNewID[-1] = -1;
-    newToOldID[-1] = -1;
+    BoneMap oldToNewID(size + 1, -1);
+    for (unsigned int newID = 0; newID < size; ++newID)
+    {
+        oldToNewID[newToOldID[newID] + 1] = static_cast<int>(newID);
+    }
 
     Pose newRestPose(size);
     Pose newBindPose(size);
@@ -139,12 +138,12 @@ BoneMap Skeleton::RearrangeSkeleton()
 
     for (unsigned int i = 0; i < size; ++i)
     {
-        const int oldID = newToOldID[static_cast<int>(i)];
+        const int oldID = static_cast<int>(newToOldID[i]);
         newRestPose.SetLocalTransform(i, m_RestPose.GetLocalTransform(oldID));
         newBindPose.SetLocalTransform(i, m_BindPose.GetLocalTransform(oldID));
         newNames[i] = GetJointName(oldID);
 
-        const int newParentID = oldToNewID[m_BindPose.GetParent(oldID)];
+        const int newParentID = oldToNewID[m_BindPose.GetParent(oldID) + 1];
         newRestPose.SetParent(i, newParentID);
         newBindPose.SetParent(i, newParentID);
     }